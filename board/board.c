@@ -48,5 +48,5 @@ void __early_init(void) {
  * Board-specific initialization code.
  */
 void boardInit(void) {
-	AFIO->MAPR |= AFIO_MAPR_USART3_REMAP;
+	AFIO->MAPR |= AFIO_MAPR_USART3_REMAP_PARTIALREMAP;  // PC10/PC11
 }
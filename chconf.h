@@ -39,14 +39,14 @@
  * @brief   System time counter resolution.
  * @note    Allowed values are 16 or 32 bits.
  */
-#define CH_CFG_ST_RESOLUTION                32
+#define CH_CFG_ST_RESOLUTION                32  // TIM2 extended in software, src/drivers/st
 
 /**
  * @brief   System tick frequency.
  * @details Frequency of the system timer that drives the system ticks. This
  *          setting also defines the system tick time unit.
  */
-#define CH_CFG_ST_FREQUENCY                 10000
+#define CH_CFG_ST_FREQUENCY                 1000000
 
 /**
  * @brief   Time delta constant for the tick-less mode.
@@ -56,7 +56,7 @@
  *          The value one is not valid, timeouts are rounded up to
  *          this value.
  */
-#define CH_CFG_ST_TIMEDELTA                 0
+#define CH_CFG_ST_TIMEDELTA                 20
 
 /** @} */
 
@@ -320,6 +320,17 @@
  */
 /*===========================================================================*/
 
+/*
+ * Release builds (make BUILD=release) turn off the kernel checks, the
+ * asserts and the trace buffer. Statistics and stack filling stay on,
+ * the thread monitor needs them and they don't cost on the API paths.
+ */
+#if defined(RELEASE_BUILD)
+#define CHCONF_DBG_CHECKS                   FALSE
+#else
+#define CHCONF_DBG_CHECKS                   TRUE
+#endif
+
 /**
  * @brief   Debug option, kernel statistics.
  *
@@ -334,7 +345,7 @@
  *
  * @note    The default is @p FALSE.
  */
-#define CH_DBG_SYSTEM_STATE_CHECK           TRUE
+#define CH_DBG_SYSTEM_STATE_CHECK           CHCONF_DBG_CHECKS
 
 /**
  * @brief   Debug option, parameters checks.
@@ -343,7 +354,7 @@
  *
  * @note    The default is @p FALSE.
  */
-#define CH_DBG_ENABLE_CHECKS                TRUE
+#define CH_DBG_ENABLE_CHECKS                CHCONF_DBG_CHECKS
 
 /**
  * @brief   Debug option, consistency checks.
@@ -353,7 +364,7 @@
  *
  * @note    The default is @p FALSE.
  */
-#define CH_DBG_ENABLE_ASSERTS               TRUE
+#define CH_DBG_ENABLE_ASSERTS               CHCONF_DBG_CHECKS
 
 /**
  * @brief   Debug option, trace buffer.
@@ -362,7 +373,7 @@
  *
  * @note    The default is @p FALSE.
  */
-#define CH_DBG_ENABLE_TRACE                TRUE
+#define CH_DBG_ENABLE_TRACE                 CHCONF_DBG_CHECKS
 
 /**
  * @brief   Debug option, stack checks.
@@ -374,7 +385,7 @@
  * @note    The default failure mode is to halt the system with the global
  *          @p panic_msg variable set to @p NULL.
  */
-#define CH_DBG_ENABLE_STACK_CHECK           TRUE
+#define CH_DBG_ENABLE_STACK_CHECK           CHCONF_DBG_CHECKS
 
 /**
  * @brief   Debug option, stacks initialization.
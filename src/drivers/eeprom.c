@@ -5,16 +5,19 @@
 
 #include "string.h"
 
+#include "led.h"
 
-void wait_for_write_end(void);
 
-static const I2CConfig i2cconfig = {
-        OPMODE_I2C,
-        100000, //100kHz
-        STD_DUTY_CYCLE };
+static msg_t wait_for_write_end(void);
+static msg_t eeprom_transfer(const uint8_t *txbuf, size_t txbytes,
+        uint8_t *rxbuf, size_t rxbytes);
 
+static eeprom_stats_t stats;
+
+// The shared bus is started by init_i2c_bus()
 void init_eeprom(void) {
-    i2cStart(&EEPROM_BUS, &i2cconfig);
+    chTMObjectInit(&stats.read_tm);
+    chTMObjectInit(&stats.write_tm);
 }
 // Erase whole eeprom storage
 void erase_eeprom(void) {
@@ -25,11 +28,18 @@ bool read_block(const void *data, uint16_t addr, size_t n) {
     msg_t res;
     uint8_t *b = (uint8_t *)data;
     uint8_t buff[2];
-    buff[0] = addr >> 8;
-    buff[1] = addr & 0xFF;
-    res = i2cMasterTransmitTimeout(&EEPROM_BUS, EEPROM_ADDRESS, buff, 2, b, n, MS2ST(5));
-    if (res != 0)
-        return false;
+    while(n > 0) {
+        // sensor traffic can take the bus between chunks
+        size_t chunk = n > EEPROM_CHUNK_SIZE ? EEPROM_CHUNK_SIZE : n;
+        buff[0] = addr >> 8;
+        buff[1] = addr & 0xFF;
+        res = eeprom_transfer(buff, 2, b, chunk);
+        if (res != 0)
+            return false;
+        addr += chunk;
+        b += chunk;
+        n -= chunk;
+    }
     return true;
 }
 
@@ -48,47 +58,117 @@ bool write_block(uint16_t addr, const void *data, size_t n) {
         send_buff[0] = addr >> 8;
         send_buff[1] = addr & 0xFF;
         memcpy(&send_buff[2], b, n);
-        res = i2cMasterTransmitTimeout(&EEPROM_BUS, EEPROM_ADDRESS, send_buff, n+2, NULL, 0, MS2ST(10));
-        if(res != MSG_OK)
+        res = eeprom_transfer(send_buff, n+2, NULL, 0);
+        if(res != MSG_OK || wait_for_write_end() != MSG_OK)
             return false;
-        wait_for_write_end();
 
     } else { //crossing page boundary max data supported is EEPROM_PAGE_SIZE
         data_size = EEPROM_PAGE_SIZE - offset;
         send_buff[0] = addr >> 8;
         send_buff[1] = addr & 0xFF;
         memcpy(&send_buff[2], b, data_size);
-        res = i2cMasterTransmitTimeout(&EEPROM_BUS, EEPROM_ADDRESS, send_buff, data_size+2, NULL, 0, MS2ST(10));
-        if(res != MSG_OK)
+        res = eeprom_transfer(send_buff, data_size+2, NULL, 0);
+        if(res != MSG_OK || wait_for_write_end() != MSG_OK)
             return false;
-        wait_for_write_end();
 
+        // rest of the data goes to the start of the next page
         addr += data_size;
+        b += data_size;
         data_size = n - data_size;
         send_buff[0] = addr >> 8;
         send_buff[1] = addr & 0xFF;
         memcpy(&send_buff[2], b, data_size);
-        res = i2cMasterTransmitTimeout(&EEPROM_BUS, EEPROM_ADDRESS, send_buff, data_size+2, NULL, 0, MS2ST(10));
-        if(res != MSG_OK)
+        res = eeprom_transfer(send_buff, data_size+2, NULL, 0);
+        if(res != MSG_OK || wait_for_write_end() != MSG_OK)
             return false;
-        wait_for_write_end();
-
-
-       // chSysHalt("EEPROM boundry");
-        return false;
     }
     return true;
 
 }
 
-void wait_for_write_end(void) {
+/*
+ * Wait for the internal write cycle, MSG_TIMEOUT if the device didn't
+ * come back within the polling window.
+ */
+static msg_t wait_for_write_end(void) {
     msg_t res;
     uint8_t n = 0;
+    uint8_t dummy = 0;
     do {
-        res = i2cMasterTransmitTimeout(&EEPROM_BUS, EEPROM_ADDRESS, (uint8_t *) 0xFF, 1, NULL, 0, MS2ST(5));
+        // ack polling, the device NACKs its address until the write cycle is done
+        // each poll is a separate storage transaction, the bus is free in between
+        res = i2c_bus_transfer(I2C_PRIO_STORAGE, EEPROM_ADDRESS, &dummy, 1, NULL, 0, MS2ST(5), NULL);
         n++;
         chThdSleepMicroseconds(500); //poling at 0.5ms inteval
-    } while(res != MSG_OK);
+    } while(res != MSG_OK && n < 40); // 24Cxx write cycle is max 5-10ms
+
+    if(res != MSG_OK) {
+        stats.errors++;
+        led_set_state(LED_STATE_EEPROM_ERROR, true);
+        return MSG_TIMEOUT;
+    }
+    return MSG_OK;
 }
 
+/*
+ * Single I2C transaction with statistics. The STM32 I2Cv1 driver moves the
+ * data with DMA so the CPU only sees a few interrupts per transaction.
+ * Bus time starts when the shared bus is granted, so the rates measure
+ * the EEPROM and not the contention with sensor traffic.
+ */
+static msg_t eeprom_transfer(const uint8_t *txbuf, size_t txbytes,
+        uint8_t *rxbuf, size_t rxbytes) {
+    i2c_bus_timing_t timing = { rxbytes ? &stats.read_tm : &stats.write_tm, 0 };
+    // worst case transfer time at bus speed (9 clocks per byte) plus margin
+    systime_t timeout = MS2ST(5) + I2C_BUS_XFER_TIME(txbytes + rxbytes);
+    msg_t res;
+
+    res = i2c_bus_transfer(I2C_PRIO_STORAGE, EEPROM_ADDRESS, txbuf, txbytes,
+            rxbuf, rxbytes, timeout, &timing);
+
+#if CH_DBG_STATISTICS
+    rtcnt_t last = timing.tm->last;
+    rttime_t busy = timing.idle < last ? last - timing.idle : 0;
+    stats.cpu_cycles += busy;
+    stats.last_cpu_load = last ? (uint8_t)(((uint64_t)busy * 100) / last) : 0;
+#endif
+
+    if(res != MSG_OK) {
+        stats.errors++;
+        led_set_state(LED_STATE_EEPROM_ERROR, true);
+        return res;
+    }
+    if(rxbytes)
+        stats.bytes_read += rxbytes;
+    else
+        stats.bytes_written += txbytes - 2;
+    return res;
+}
+
+const eeprom_stats_t *eeprom_get_stats(void) {
+    return &stats;
+}
+
+// bytes/s of read transfers measured on the bus
+uint32_t eeprom_read_rate(void) {
+    if(stats.read_tm.cumulative == 0)
+        return 0;
+    return (uint32_t)(((uint64_t)stats.bytes_read * STM32_HCLK) / stats.read_tm.cumulative);
+}
+
+// bytes/s of write transfers, without the write cycle time
+uint32_t eeprom_write_rate(void) {
+    if(stats.write_tm.cumulative == 0)
+        return 0;
+    return (uint32_t)(((uint64_t)stats.bytes_written * STM32_HCLK) / stats.write_tm.cumulative);
+}
+
+// CPU load while transferring in percent of bus time, over all transfers.
+// The load of the last transfer is in eeprom_get_stats()->last_cpu_load.
+uint8_t eeprom_cpu_load(void) {
+    rttime_t total = stats.read_tm.cumulative + stats.write_tm.cumulative;
+    if(total == 0)
+        return 0;
+    return (uint8_t)((stats.cpu_cycles * 100) / total);
+}
 
@@ -3,6 +3,34 @@
 
 #include "hal.h"
 
+#include "i2c_bus.h"
+
+// 24C32 EEPROM on the shared I2C bus
+#define EEPROM_ADDRESS      0x50
+#define EEPROM_SIZE         4096
+#define EEPROM_PAGE_SIZE    32
+
+// Reads are split into transactions of this size so sensor traffic
+// never waits for more than one chunk
+#ifndef EEPROM_CHUNK_SIZE
+#define EEPROM_CHUNK_SIZE   16
+#endif
+
+// Transfer statistics. Time is measured in realtime counter cycles,
+// bus time runs from bus grant to release, waiting for the shared bus
+// is not included, cpu time is the part of it
+// the CPU was not idle (only available with CH_DBG_STATISTICS).
+// errors counts failed transactions and write cycles that timed out.
+typedef struct {
+    uint32_t bytes_read;
+    uint32_t bytes_written;
+    uint32_t errors;
+    time_measurement_t read_tm;
+    time_measurement_t write_tm;
+    uint64_t cpu_cycles;
+    uint8_t last_cpu_load;      // percent of bus time, last transfer
+} eeprom_stats_t;
+
 void init_eeprom(void);
 // Erase whole eeprom storage
 void erase_eeprom(void);
@@ -10,5 +38,10 @@ void erase_eeprom(void);
 bool read_block(const void *data, uint16_t addr, size_t n);
 bool write_block(uint16_t addr, const void *data, size_t n);
 
+const eeprom_stats_t *eeprom_get_stats(void);
+uint32_t eeprom_read_rate(void);
+uint32_t eeprom_write_rate(void);
+uint8_t eeprom_cpu_load(void);
+
 
 #endif /* SRC_DRIVERS_EEPROM_H_ */
@@ -0,0 +1,133 @@
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "eeprom_cache.h"
+#include "storage.h"
+
+#define BITMAP_WORDS ((EEPROM_CACHE_PAGES + 31) / 32)
+
+#define BIT_SET(map, page)   (map[(page) / 32] |= (1UL << ((page) % 32)))
+#define BIT_CLEAR(map, page) (map[(page) / 32] &= ~(1UL << ((page) % 32)))
+#define BIT_TEST(map, page)  (map[(page) / 32] & (1UL << ((page) % 32)))
+
+static uint8_t mirror[EEPROM_CACHE_SIZE];
+static uint32_t valid[BITMAP_WORDS];
+static uint32_t dirty[BITMAP_WORDS];
+static eeprom_cache_stats_t stats;
+
+// make sure page is in RAM
+static bool load_page(uint16_t page) {
+    if(BIT_TEST(valid, page)) {
+        stats.hits++;
+        return true;
+    }
+    if(!read_block(&mirror[page * EEPROM_PAGE_SIZE], page * EEPROM_PAGE_SIZE, EEPROM_PAGE_SIZE))
+        return false;
+    BIT_SET(valid, page);
+    stats.page_loads++;
+    return true;
+}
+
+bool eeprom_cache_read(const void *data, uint16_t addr, size_t n) {
+    uint8_t *b = (uint8_t *)data;
+
+    while(n > 0 && addr < EEPROM_CACHE_SIZE) {
+        uint16_t page = addr / EEPROM_PAGE_SIZE;
+        uint16_t offset = addr % EEPROM_PAGE_SIZE;
+        size_t len = EEPROM_PAGE_SIZE - offset;
+        if(len > n)
+            len = n;
+
+        if(!load_page(page))
+            return false;
+        memcpy(b, &mirror[addr], len);
+
+        addr += len;
+        b += len;
+        n -= len;
+    }
+    if(n > 0) {
+        // not mirrored
+        return read_block(b, addr, n);
+    }
+    return true;
+}
+
+// Writes only touch RAM, the page is written to the device on flush.
+bool eeprom_cache_write(uint16_t addr, const void *data, size_t n) {
+    const uint8_t *b = (const uint8_t *)data;
+
+    while(n > 0) {
+        uint16_t page = addr / EEPROM_PAGE_SIZE;
+        uint16_t offset = addr % EEPROM_PAGE_SIZE;
+        size_t len = EEPROM_PAGE_SIZE - offset;
+        if(len > n)
+            len = n;
+
+        if(addr >= EEPROM_CACHE_SIZE) {
+            // not mirrored, write_block can't cross a page boundary
+            if(!write_block(addr, b, len))
+                return false;
+        } else {
+            // whole pages are flushed so partially written pages must be loaded first
+            if(len < EEPROM_PAGE_SIZE && !load_page(page))
+                return false;
+            if(!BIT_TEST(valid, page) || memcmp(&mirror[addr], b, len) != 0) {
+                memcpy(&mirror[addr], b, len);
+                BIT_SET(valid, page);
+                BIT_SET(dirty, page);
+            }
+        }
+
+        addr += len;
+        b += len;
+        n -= len;
+    }
+    return true;
+}
+
+// Write all dirty pages to the device, one page write each. Pages are
+// written from the top down so a new sentinal lands before the header
+// that makes the variable in front of it visible.
+bool eeprom_cache_flush(void) {
+    bool ok = true;
+    for(uint16_t page = EEPROM_CACHE_PAGES; page-- > 0;) {
+        if(!BIT_TEST(dirty, page))
+            continue;
+        if(write_block(page * EEPROM_PAGE_SIZE, &mirror[page * EEPROM_PAGE_SIZE], EEPROM_PAGE_SIZE)) {
+            BIT_CLEAR(dirty, page);
+            stats.page_writes++;
+        } else {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// Drop everything, dirty pages are lost
+void eeprom_cache_invalidate(void) {
+    memset(valid, 0, sizeof(valid));
+    memset(dirty, 0, sizeof(dirty));
+}
+
+const eeprom_cache_stats_t *eeprom_cache_get_stats(void) {
+    return &stats;
+}
+
+static bool cache_init(void) {
+    init_eeprom();
+    eeprom_cache_invalidate();
+    return true;
+}
+
+const storage_backend_t storage_eeprom = {
+    "eeprom",
+    EEPROM_SIZE,
+    cache_init,
+    eeprom_cache_read,
+    eeprom_cache_write,
+    eeprom_cache_flush,
+    NULL
+};
@@ -0,0 +1,32 @@
+#ifndef SRC_DRIVERS_EEPROM_CACHE_H_
+#define SRC_DRIVERS_EEPROM_CACHE_H_
+
+#include "hal.h"
+
+#include "eeprom.h"
+
+// Number of bytes mirrored in RAM starting at address 0. Must be a
+// multiple of EEPROM_PAGE_SIZE, accesses above it go to the device.
+#ifndef EEPROM_CACHE_SIZE
+#define EEPROM_CACHE_SIZE   512
+#endif
+
+#define EEPROM_CACHE_PAGES  (EEPROM_CACHE_SIZE / EEPROM_PAGE_SIZE)
+
+#if (EEPROM_CACHE_SIZE % EEPROM_PAGE_SIZE) != 0 || EEPROM_CACHE_SIZE > EEPROM_SIZE
+#error "EEPROM_CACHE_SIZE must be a multiple of EEPROM_PAGE_SIZE within EEPROM_SIZE"
+#endif
+
+typedef struct {
+    uint32_t page_loads;    // pages read from the device
+    uint32_t page_writes;   // pages written to the device
+    uint32_t hits;          // page accesses served from RAM
+} eeprom_cache_stats_t;
+
+bool eeprom_cache_read(const void *data, uint16_t addr, size_t n);
+bool eeprom_cache_write(uint16_t addr, const void *data, size_t n);
+bool eeprom_cache_flush(void);
+void eeprom_cache_invalidate(void);
+const eeprom_cache_stats_t *eeprom_cache_get_stats(void);
+
+#endif /* SRC_DRIVERS_EEPROM_CACHE_H_ */
@@ -0,0 +1,266 @@
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "flash_storage.h"
+#include "storage.h"
+#include "supervisor.h"
+
+#define PAGE_MAGIC      0x4C4D5345  // "ESML"
+#define ERASED_HWORD    0xFFFF
+
+#define FLASH_KEY1_VALUE 0x45670123
+#define FLASH_KEY2_VALUE 0xCDEF89AB
+
+// Page header, programmed last when a page becomes active
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+} page_header_t;
+
+// Log record, the offset is programmed last and makes the record valid
+typedef struct {
+    uint16_t offset;
+    uint16_t value;
+} log_record_t;
+
+static uint8_t active = 0;
+static uint32_t sequence = 0;
+static uint16_t next_record = 0;    // first free record of the active page
+static uint16_t image[FLASH_STORAGE_SIZE / 2];
+static flash_storage_stats_t stats;
+
+static inline uint32_t page_addr(uint8_t page) {
+    return FLASH_STORAGE_BASE + page * FLASH_STORAGE_PAGE_SIZE;
+}
+
+static inline const page_header_t *page_header(uint8_t page) {
+    return (const page_header_t *)page_addr(page);
+}
+
+static inline volatile log_record_t *page_records(uint8_t page) {
+    return (volatile log_record_t *)(page_addr(page) + FLASH_STORAGE_HEADER);
+}
+
+/*
+ * The CPU stalls while the flash erases or programs, up to 40 ms for a
+ * page erase, so the supervisor is paused for as long as it is unlocked.
+ */
+static void flash_unlock(void) {
+    supervisor_pause();
+    if(FLASH->CR & FLASH_CR_LOCK) {
+        FLASH->KEYR = FLASH_KEY1_VALUE;
+        FLASH->KEYR = FLASH_KEY2_VALUE;
+    }
+}
+
+static void flash_lock(void) {
+    FLASH->CR |= FLASH_CR_LOCK;
+    supervisor_resume();
+}
+
+static bool flash_wait(void) {
+    while(FLASH->SR & FLASH_SR_BSY)
+        ;
+    if(FLASH->SR & (FLASH_SR_PGERR | FLASH_SR_WRPRTERR)) {
+        FLASH->SR = FLASH_SR_PGERR | FLASH_SR_WRPRTERR;
+        stats.errors++;
+        return false;
+    }
+    FLASH->SR = FLASH_SR_EOP;
+    return true;
+}
+
+// F1 flash can only program an erased halfword
+static bool program_hword(volatile uint16_t *dst, uint16_t value) {
+    bool ok;
+    FLASH->CR |= FLASH_CR_PG;
+    *dst = value;
+    ok = flash_wait();
+    FLASH->CR &= ~FLASH_CR_PG;
+    return ok && *dst == value;
+}
+
+// Stalls the CPU for the erase time (~20ms), only done on compactions
+static bool erase_page(uint8_t page) {
+    bool ok;
+    FLASH->CR |= FLASH_CR_PER;
+    FLASH->AR = page_addr(page);
+    FLASH->CR |= FLASH_CR_STRT;
+    ok = flash_wait();
+    FLASH->CR &= ~FLASH_CR_PER;
+    stats.erases++;
+    return ok;
+}
+
+static bool page_erased(uint8_t page) {
+    const uint32_t *p = (const uint32_t *)page_addr(page);
+    for(uint16_t i = 0; i < FLASH_STORAGE_PAGE_SIZE / 4; i++) {
+        if(p[i] != 0xFFFFFFFF)
+            return false;
+    }
+    return true;
+}
+
+static bool write_header(uint8_t page, uint32_t seq) {
+    volatile uint16_t *h = (volatile uint16_t *)page_addr(page);
+    return program_hword(&h[2], seq & 0xFFFF) &&
+           program_hword(&h[3], seq >> 16) &&
+           program_hword(&h[0], PAGE_MAGIC & 0xFFFF) &&
+           program_hword(&h[1], PAGE_MAGIC >> 16);
+}
+
+// New value of the halfword at aligned addr a after writing data to [addr, addr+n)
+static uint16_t merged_hword(uint16_t a, uint16_t addr, const uint8_t *data, size_t n,
+        uint16_t old) {
+    uint8_t b[2] = { old & 0xFF, old >> 8 };
+    for(uint8_t i = 0; i < 2; i++) {
+        if(a + i >= addr && a + i < addr + n)
+            b[i] = data[a + i - addr];
+    }
+    return b[0] | (b[1] << 8);
+}
+
+// Rebuild the RAM image from the log of a page
+static void replay(uint8_t page) {
+    volatile log_record_t *r = page_records(page);
+
+    memset(image, 0xFF, sizeof(image));
+    for(next_record = 0; next_record < FLASH_STORAGE_RECORDS; next_record++) {
+        uint16_t offset = r[next_record].offset;
+        uint16_t value = r[next_record].value;
+        if(offset == ERASED_HWORD) {
+            if(value == ERASED_HWORD)
+                break;      // end of the log
+            continue;       // power lost before the offset was programmed
+        }
+        if(offset < FLASH_STORAGE_SIZE && (offset & 1) == 0)
+            image[offset / 2] = value;
+    }
+}
+
+// Append a record to the active page, the slot is used up even on failure
+static bool append(uint16_t offset, uint16_t value) {
+    volatile log_record_t *r = &page_records(active)[next_record++];
+
+    stats.records++;
+    if(value != ERASED_HWORD && !program_hword(&r->value, value))
+        return false;
+    return program_hword(&r->offset, offset);
+}
+
+/*
+ * Write the RAM image into the other page, one record per programmed
+ * halfword, then activate it with the next sequence number. A power loss
+ * before the header is programmed leaves the old page active.
+ */
+static bool compact(void) {
+    uint8_t next = active ^ 1;
+    volatile log_record_t *r = page_records(next);
+    uint16_t n = 0;
+
+    stats.compactions++;
+    if(!page_erased(next) && !erase_page(next))
+        return false;
+
+    for(uint16_t i = 0; i < FLASH_STORAGE_SIZE / 2; i++) {
+        if(image[i] == ERASED_HWORD)
+            continue;
+        if(!program_hword(&r[n].value, image[i]) || !program_hword(&r[n].offset, i * 2))
+            return false;
+        n++;
+    }
+    if(!write_header(next, sequence + 1))
+        return false;
+
+    active = next;
+    sequence++;
+    next_record = n;
+    return true;
+}
+
+static bool flash_init(void) {
+    const page_header_t *h0 = page_header(0);
+    const page_header_t *h1 = page_header(1);
+    bool v0 = h0->magic == PAGE_MAGIC;
+    bool v1 = h1->magic == PAGE_MAGIC;
+
+    if(v0 && (!v1 || h0->sequence > h1->sequence)) {
+        active = 0;
+    } else if(v1) {
+        active = 1;
+    } else {
+        // no valid page, start an empty log
+        bool ok;
+        flash_unlock();
+        ok = (page_erased(0) || erase_page(0)) && write_header(0, 1);
+        flash_lock();
+        active = 0;
+        sequence = 1;
+        next_record = 0;
+        memset(image, 0xFF, sizeof(image));
+        return ok;
+    }
+    sequence = page_header(active)->sequence;
+    replay(active);
+    return true;
+}
+
+static bool flash_read(const void *data, uint16_t addr, size_t n) {
+    memcpy((void *)data, (const uint8_t *)image + addr, n);
+    return true;
+}
+
+/*
+ * Changed halfwords are appended to the log. If they don't all fit the
+ * write goes to the image and the image is compacted into the other page,
+ * a failed compaction is retried by the next write.
+ */
+static bool flash_write(uint16_t addr, const void *data, size_t n) {
+    const uint8_t *b = (const uint8_t *)data;
+    uint16_t first = addr & ~1;
+    uint16_t changed = 0;
+    bool ok = true;
+
+    for(uint16_t a = first; a < addr + n; a += 2) {
+        if(merged_hword(a, addr, b, n, image[a / 2]) != image[a / 2])
+            changed++;
+    }
+    if(changed == 0)
+        return true;
+
+    flash_unlock();
+    if(next_record + changed <= FLASH_STORAGE_RECORDS) {
+        for(uint16_t a = first; a < addr + n && ok; a += 2) {
+            uint16_t v = merged_hword(a, addr, b, n, image[a / 2]);
+            if(v != image[a / 2] && (ok = append(a, v)))
+                image[a / 2] = v;
+        }
+    } else {
+        for(uint16_t a = first; a < addr + n; a += 2)
+            image[a / 2] = merged_hword(a, addr, b, n, image[a / 2]);
+        ok = compact();
+    }
+    flash_lock();
+    return ok;
+}
+
+static bool flash_flush(void) {
+    return true;
+}
+
+// Not memory mapped, the flash holds a log and not the image
+const storage_backend_t storage_flash = {
+    "flash",
+    FLASH_STORAGE_SIZE,
+    flash_init,
+    flash_read,
+    flash_write,
+    flash_flush,
+    NULL
+};
+
+const flash_storage_stats_t *flash_storage_get_stats(void) {
+    return &stats;
+}
@@ -0,0 +1,49 @@
+#ifndef SRC_DRIVERS_FLASH_STORAGE_H_
+#define SRC_DRIVERS_FLASH_STORAGE_H_
+
+#include "hal.h"
+
+/*
+ * EEPROM emulation in two pages of internal flash. The active page is an
+ * append-only log of (offset, value) halfword records after a header, a
+ * write appends one record per changed halfword. When the log is full the
+ * current image is compacted into the other page, so a page is only erased
+ * once every FLASH_STORAGE_RECORDS records and erases alternate between
+ * the two pages. Reads are served from a RAM image rebuilt from the log
+ * at init.
+ *
+ * The pages are reserved at the end of flash by the linker script
+ * (board/STM32F103xB_storage.ld, selected with make STORAGE=flash), which
+ * also provides their address.
+ */
+#if defined(STM32F103xE)
+#define FLASH_STORAGE_PAGE_SIZE 2048
+#else
+#define FLASH_STORAGE_PAGE_SIZE 1024
+#endif
+
+extern const uint8_t __flash_storage_base__[];
+#define FLASH_STORAGE_BASE      ((uint32_t)__flash_storage_base__)
+
+#define FLASH_STORAGE_HEADER    8
+#define FLASH_STORAGE_RECORDS   ((FLASH_STORAGE_PAGE_SIZE - FLASH_STORAGE_HEADER) / 4)
+
+// Emulated size, a compacted image must leave room in the log
+#ifndef FLASH_STORAGE_SIZE
+#define FLASH_STORAGE_SIZE      512
+#endif
+
+#if FLASH_STORAGE_SIZE / 2 >= FLASH_STORAGE_RECORDS
+#error "FLASH_STORAGE_SIZE leaves no room for the log"
+#endif
+
+typedef struct {
+    uint32_t erases;
+    uint32_t records;       // halfwords appended to the log
+    uint32_t compactions;   // writes that found the log full
+    uint32_t errors;
+} flash_storage_stats_t;
+
+const flash_storage_stats_t *flash_storage_get_stats(void);
+
+#endif /* SRC_DRIVERS_FLASH_STORAGE_H_ */
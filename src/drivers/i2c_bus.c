@@ -0,0 +1,216 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "i2c_bus.h"
+
+typedef struct {
+    systime_t period;
+    systime_t duration;
+    systime_t next_due;
+} periodic_slot_t;
+
+static void bus_recover(void);
+
+static const I2CConfig i2cconfig = {
+        OPMODE_I2C,
+        I2C_BUS_SPEED,
+        I2C_BUS_DUTY };
+
+static mutex_t bus_mtx;
+static condition_variable_t bus_cond;
+static bool busy = false;
+static uint8_t sensor_waiting = 0;
+
+static periodic_slot_t slots[I2C_BUS_MAX_PERIODIC];
+static uint8_t num_slots = 0;
+
+static i2c_bus_stats_t stats;
+
+void init_i2c_bus(void) {
+    chMtxObjectInit(&bus_mtx);
+    chCondObjectInit(&bus_cond);
+
+    palSetPadMode(I2C_BUS_SCL_PORT, I2C_BUS_SCL_PAD, PAL_MODE_STM32_ALTERNATE_OPENDRAIN);
+    palSetPadMode(I2C_BUS_SDA_PORT, I2C_BUS_SDA_PAD, PAL_MODE_STM32_ALTERNATE_OPENDRAIN);
+    i2cStart(&I2C_BUS, &i2cconfig);
+}
+
+// Reserve bus time for a periodic sensor transaction, returns slot or -1
+int8_t i2c_bus_add_periodic(systime_t period, systime_t duration) {
+    int8_t slot;
+
+    chMtxLock(&bus_mtx);
+    if(num_slots >= I2C_BUS_MAX_PERIODIC) {
+        chMtxUnlock(&bus_mtx);
+        return -1;
+    }
+    slot = num_slots;
+    slots[slot].period = period;
+    slots[slot].duration = duration;
+    slots[slot].next_due = chVTGetSystemTimeX() + period;
+    num_slots++;
+    chMtxUnlock(&bus_mtx);
+    return slot;
+}
+
+// Called by the sensor at the start of each cycle, schedules the next one
+void i2c_bus_periodic_start(int8_t slot) {
+    chMtxLock(&bus_mtx);
+    if(slot >= 0 && slot < num_slots)
+        slots[slot].next_due = chVTGetSystemTimeX() + slots[slot].period;
+    chMtxUnlock(&bus_mtx);
+}
+
+/*
+ * Move a slot whose sensor missed its start onto the next point of its
+ * grid. Without this a stale next_due comes back into the window after
+ * the system time wraps and defers storage for no reason.
+ */
+static void slot_catch_up(periodic_slot_t *slot, systime_t now) {
+    systime_t late = now - slot->next_due;
+    // wrap-safe: past its due time and its transaction
+    if(late < (systime_t)(TIME_INFINITE / 2) && late > slot->duration && slot->period > 0)
+        slot->next_due += (late / slot->period + 1) * slot->period;
+}
+
+/*
+ * Time a storage transaction taking duration has to wait so it doesn't
+ * overlap a periodic sensor transaction. Zero if it can start now.
+ * Called with the bus mutex held.
+ */
+static systime_t storage_delay(systime_t duration) {
+    systime_t now = chVTGetSystemTimeX();
+    systime_t delay = 0;
+    for(uint8_t i = 0; i < num_slots; i++) {
+        slot_catch_up(&slots[i], now);
+        systime_t due = slots[i].next_due;
+        // sensor due now or before we would be done, or still running
+        if(chVTIsTimeWithinX(due, now, now + duration + 1) ||
+           chVTIsTimeWithinX(now, due, due + slots[i].duration)) {
+            systime_t d = due + slots[i].duration - now;
+            if(d > delay)
+                delay = d;
+        }
+    }
+    return delay;
+}
+
+static void bus_acquire(i2c_prio_t prio, systime_t duration) {
+    chMtxLock(&bus_mtx);
+    if(prio == I2C_PRIO_SENSOR) {
+        systime_t start = chVTGetSystemTimeX();
+        sensor_waiting++;
+        while(busy)
+            chCondWait(&bus_cond);
+        sensor_waiting--;
+        systime_t waited = chVTGetSystemTimeX() - start;
+        if(waited > stats.sensor_wait_max)
+            stats.sensor_wait_max = waited;
+    } else {
+        while(true) {
+            if(busy || sensor_waiting > 0) {
+                chCondWait(&bus_cond);
+                continue;
+            }
+            systime_t delay = storage_delay(duration);
+            if(delay == 0)
+                break;
+            stats.storage_deferred++;
+            // the mutex is not re-acquired when the wait times out
+            if(chCondWaitTimeout(&bus_cond, delay) == MSG_TIMEOUT)
+                chMtxLock(&bus_mtx);
+        }
+    }
+    busy = true;
+    chMtxUnlock(&bus_mtx);
+}
+
+static void bus_release(void) {
+    chMtxLock(&bus_mtx);
+    busy = false;
+    chCondBroadcast(&bus_cond);
+    chMtxUnlock(&bus_mtx);
+}
+
+/*
+ * One bounded I2C transaction. Callers moving large amounts of data
+ * (EEPROM) must split it into short transactions, the bus is handed to
+ * waiting sensor traffic between them. timing may be NULL.
+ */
+msg_t i2c_bus_transfer(i2c_prio_t prio, i2caddr_t addr,
+        const uint8_t *txbuf, size_t txbytes,
+        uint8_t *rxbuf, size_t rxbytes, systime_t timeout,
+        i2c_bus_timing_t *timing) {
+    msg_t res;
+#if CH_DBG_STATISTICS
+    thread_t *idle = chSysGetIdleThreadX();
+    rttime_t idle_start = 0;
+#endif
+
+    bus_acquire(prio, I2C_BUS_XFER_TIME(txbytes + rxbytes));
+    if(timing != NULL) {
+#if CH_DBG_STATISTICS
+        idle_start = idle->p_stats.cumulative;
+#endif
+        chTMStartMeasurementX(timing->tm);
+    }
+    res = i2cMasterTransmitTimeout(&I2C_BUS, addr, txbuf, txbytes,
+            rxbuf, rxbytes, timeout);
+    if(res == MSG_TIMEOUT)
+        bus_recover();
+    if(timing != NULL) {
+        chTMStopMeasurementX(timing->tm);
+#if CH_DBG_STATISTICS
+        timing->idle = idle->p_stats.cumulative - idle_start;
+#else
+        timing->idle = 0;
+#endif
+    }
+    bus_release();
+
+    return res;
+}
+
+/*
+ * I2C bus lockup recovery. A slave interrupted in the middle of a read keeps
+ * SDA low and waits for more clocks, so SCL is toggled by hand (up to 9
+ * clocks) until SDA is released, then a STOP condition is generated and the
+ * peripheral restarted.
+ */
+static void bus_recover(void) {
+    const rtcnt_t half_clock = US2RTC(STM32_HCLK, 5);
+
+    i2cStop(&I2C_BUS);
+
+    palSetPad(I2C_BUS_SCL_PORT, I2C_BUS_SCL_PAD);
+    palSetPad(I2C_BUS_SDA_PORT, I2C_BUS_SDA_PAD);
+    palSetPadMode(I2C_BUS_SCL_PORT, I2C_BUS_SCL_PAD, PAL_MODE_OUTPUT_OPENDRAIN);
+    palSetPadMode(I2C_BUS_SDA_PORT, I2C_BUS_SDA_PAD, PAL_MODE_OUTPUT_OPENDRAIN);
+
+    for(uint8_t i = 0; i < 9 && !palReadPad(I2C_BUS_SDA_PORT, I2C_BUS_SDA_PAD); i++) {
+        palClearPad(I2C_BUS_SCL_PORT, I2C_BUS_SCL_PAD);
+        chSysPolledDelayX(half_clock);
+        palSetPad(I2C_BUS_SCL_PORT, I2C_BUS_SCL_PAD);
+        chSysPolledDelayX(half_clock);
+    }
+
+    // STOP condition, SDA rising while SCL is high
+    palClearPad(I2C_BUS_SCL_PORT, I2C_BUS_SCL_PAD);
+    chSysPolledDelayX(half_clock);
+    palClearPad(I2C_BUS_SDA_PORT, I2C_BUS_SDA_PAD);
+    chSysPolledDelayX(half_clock);
+    palSetPad(I2C_BUS_SCL_PORT, I2C_BUS_SCL_PAD);
+    chSysPolledDelayX(half_clock);
+    palSetPad(I2C_BUS_SDA_PORT, I2C_BUS_SDA_PAD);
+    chSysPolledDelayX(half_clock);
+
+    palSetPadMode(I2C_BUS_SCL_PORT, I2C_BUS_SCL_PAD, PAL_MODE_STM32_ALTERNATE_OPENDRAIN);
+    palSetPadMode(I2C_BUS_SDA_PORT, I2C_BUS_SDA_PAD, PAL_MODE_STM32_ALTERNATE_OPENDRAIN);
+    i2cStart(&I2C_BUS, &i2cconfig);
+
+    stats.recoveries++;
+}
+
+const i2c_bus_stats_t *i2c_bus_get_stats(void) {
+    return &stats;
+}
@@ -0,0 +1,73 @@
+#ifndef SRC_DRIVERS_I2C_BUS_H_
+#define SRC_DRIVERS_I2C_BUS_H_
+
+#include "hal.h"
+
+#include "timebase.h"
+
+// Shared I2C1 bus (PB6 SCL, PB7 SDA), IMU and EEPROM
+#define I2C_BUS             I2CD1
+#define I2C_BUS_SCL_PORT    GPIOB
+#define I2C_BUS_SCL_PAD     6
+#define I2C_BUS_SDA_PORT    GPIOB
+#define I2C_BUS_SDA_PAD     7
+
+// I2C bus profiles
+#define I2C_BUS_STANDARD    0   // 100kHz standard mode
+#define I2C_BUS_FAST        1   // 400kHz fast mode
+
+#ifndef I2C_BUS_PROFILE
+#define I2C_BUS_PROFILE     I2C_BUS_FAST
+#endif
+
+#if I2C_BUS_PROFILE == I2C_BUS_FAST
+#define I2C_BUS_SPEED       400000
+#define I2C_BUS_DUTY        FAST_DUTY_CYCLE_2
+#else
+#define I2C_BUS_SPEED       100000
+#define I2C_BUS_DUTY        STD_DUTY_CYCLE
+#endif
+
+// Max number of periodic sensor reservations
+#define I2C_BUS_MAX_PERIODIC    2
+
+// Bus time of a transaction moving n bytes (9 clocks per byte, address
+// byte and repeated start included) plus a fixed margin
+#define I2C_BUS_XFER_TIME(n) (TIMEBASE_US2ST(((uint64_t)(n) + 2) * 9 * 1000000 / I2C_BUS_SPEED) + 1)
+
+/*
+ * Priority classes. Sensor traffic always wins the bus, storage traffic
+ * only gets the bus when no sensor transaction is waiting and no periodic
+ * sensor transaction is due before the storage transaction would end.
+ */
+typedef enum {
+    I2C_PRIO_SENSOR = 0,
+    I2C_PRIO_STORAGE,
+} i2c_prio_t;
+
+/*
+ * Optional timing of a transaction, from bus grant to release. Waiting
+ * for the shared bus is not included. idle is the realtime counter time
+ * the idle thread ran meanwhile, only counted with CH_DBG_STATISTICS.
+ */
+typedef struct {
+    time_measurement_t *tm;
+    rttime_t idle;
+} i2c_bus_timing_t;
+
+typedef struct {
+    uint32_t recoveries;
+    uint32_t storage_deferred;      // storage transactions delayed for sensor slots
+    systime_t sensor_wait_max;      // longest a sensor transaction waited for the bus
+} i2c_bus_stats_t;
+
+void init_i2c_bus(void);
+msg_t i2c_bus_transfer(i2c_prio_t prio, i2caddr_t addr,
+        const uint8_t *txbuf, size_t txbytes,
+        uint8_t *rxbuf, size_t rxbytes, systime_t timeout,
+        i2c_bus_timing_t *timing);
+int8_t i2c_bus_add_periodic(systime_t period, systime_t duration);
+void i2c_bus_periodic_start(int8_t slot);
+const i2c_bus_stats_t *i2c_bus_get_stats(void);
+
+#endif /* SRC_DRIVERS_I2C_BUS_H_ */
@@ -0,0 +1,66 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "led.h"
+
+static virtual_timer_t led_vt;
+static volatile uint8_t state = 0;
+static uint8_t step = 0;
+static uint8_t overrun_hold = 0;    // steps left before OVERRUN clears
+
+static uint16_t led0_pattern(uint8_t s) {
+    // parameter load started but not done, fast blink, else heartbeat
+    if(s & LED_STATE_PARAMS_PENDING)
+        return LED_PATTERN_FAST;
+    return LED_PATTERN_SLOW;
+}
+
+static uint16_t led1_pattern(uint8_t s) {
+    if(s & LED_STATE_OVERRUN)
+        return LED_PATTERN_ON;
+    if(s & LED_STATE_EEPROM_ERROR)
+        return LED_PATTERN_TRIPLE;
+    if(s & LED_STATE_RC_LOST)
+        return LED_PATTERN_DOUBLE;
+    return LED_PATTERN_OFF;
+}
+
+static void led_cb(void *arg) {
+    uint16_t mask = 0x8000 >> step;
+    uint8_t s = state;
+    (void) arg;
+
+    palWritePad(GPIOB, GPIOB_LED0, (led0_pattern(s) & mask) ? PAL_HIGH : PAL_LOW);
+    palWritePad(GPIOB, GPIOB_LED1, (led1_pattern(s) & mask) ? PAL_HIGH : PAL_LOW);
+    step = (step + 1) & 0x0F;
+
+    chSysLockFromISR();
+    if(overrun_hold > 0 && --overrun_hold == 0)
+        state &= ~LED_STATE_OVERRUN;
+    chVTSetI(&led_vt, MS2ST(LED_STEP_MS), led_cb, NULL);
+    chSysUnlockFromISR();
+}
+
+void init_led(void) {
+    chVTObjectInit(&led_vt);
+    chVTSet(&led_vt, MS2ST(LED_STEP_MS), led_cb, NULL);
+}
+
+void led_set_stateI(uint8_t s, bool on) {
+    if(on && (s & LED_STATE_OVERRUN))
+        overrun_hold = LED_OVERRUN_HOLD_MS / LED_STEP_MS;
+    if(on)
+        state |= s;
+    else
+        state &= ~s;
+}
+
+void led_set_state(uint8_t s, bool on) {
+    syssts_t sts = chSysGetStatusAndLockX();
+    led_set_stateI(s, on);
+    chSysRestoreStatusX(sts);
+}
+
+uint8_t led_get_state(void) {
+    return state;
+}
@@ -0,0 +1,35 @@
+#ifndef SRC_DRIVERS_LED_H_
+#define SRC_DRIVERS_LED_H_
+
+#include "hal.h"
+
+/*
+ * Status LEDs driven by one virtual timer, no thread. Each LED plays a
+ * 16 step pattern, one bit per LED_STEP_MS step, MSB first. LED0 shows
+ * the system state, LED1 the highest priority fault that is set.
+ */
+#define LED_STEP_MS         100
+// OVERRUN clears after this long without a new overrun
+#define LED_OVERRUN_HOLD_MS 2000
+
+// states, higher bits win on LED1
+#define LED_STATE_PARAMS_PENDING    0x01    // loading from storage, not done
+#define LED_STATE_RC_LOST           0x02
+#define LED_STATE_EEPROM_ERROR      0x04
+#define LED_STATE_OVERRUN           0x08
+
+// patterns
+#define LED_PATTERN_OFF         0x0000
+#define LED_PATTERN_ON          0xFFFF
+#define LED_PATTERN_SLOW        0xFF00      // 0.8 s on, 0.8 s off
+#define LED_PATTERN_FAST        0xAAAA      // 5 Hz
+#define LED_PATTERN_SINGLE      0x8000      // one flash
+#define LED_PATTERN_DOUBLE      0xA000      // two flashes
+#define LED_PATTERN_TRIPLE      0xA800      // three flashes
+
+void init_led(void);
+void led_set_state(uint8_t state, bool on);
+void led_set_stateI(uint8_t state, bool on);
+uint8_t led_get_state(void);
+
+#endif /* SRC_DRIVERS_LED_H_ */
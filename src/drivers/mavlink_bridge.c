@@ -0,0 +1,225 @@
+#include <string.h>
+
+#include "mavlink_bridge.h"
+#include "uart_dma.h"
+
+mavlink_system_t mavlink_system = {1, 100}; /* SysID, CompID */
+mavlink_status_t m_mavlink_status[MAVLINK_COMM_NUM_BUFFERS];
+
+typedef struct {
+    uart_dma_t *udp;        // DMA UART link
+    thread_t *rx_thread;    // signalled with EVENT_MASK(chan) on RX
+    mutex_t mtx;            // held by the sender around a whole message
+    uint8_t *frame;         // frame being filled, NULL if dropped
+    uint16_t pos;
+    time_measurement_t tx_tm;   // CPU time from start to end of a message
+} mavlink_link_t;
+
+// TX frame, word aligned for the free list link of the pool
+typedef union {
+    uint8_t data[MAVLINK_MAX_PACKET_LEN];
+    uint32_t align;
+} mavlink_frame_t;
+
+POOL_DEF(frame_pool, "mav_frame", mavlink_frame_t, MAVLINK_TX_POOL_FRAMES);
+
+static void rx_cb(uart_dma_t *udp, uint8_t events);
+
+static uint8_t uart1_rx_buf[MAVLINK_RX_BUF_SIZE];
+
+static const uart_dma_config_t uart1_config = {
+    MAVLINK_BAUD,
+    0,
+    0,
+    uart1_rx_buf,
+    sizeof(uart1_rx_buf),
+    rx_cb,
+    &frame_pool,
+    MAVLINK_TX_FRAMES
+};
+
+#if MAVLINK_USE_USART3
+static uint8_t uart3_rx_buf[MAVLINK_RX_BUF_SIZE];
+
+static const uart_dma_config_t uart3_config = {
+    MAVLINK_BAUD,
+    0,
+    0,
+    uart3_rx_buf,
+    sizeof(uart3_rx_buf),
+    rx_cb,
+    &frame_pool,
+    MAVLINK_TX_FRAMES
+};
+#endif
+
+static mavlink_link_t links[MAVLINK_NUM_LINKS];
+
+static bool link_active(const mavlink_link_t *link) {
+    return link->udp != NULL;
+}
+
+static mavlink_link_t *get_link(mavlink_channel_t chan) {
+    if(chan >= MAVLINK_NUM_LINKS || !link_active(&links[chan]))
+        return NULL;
+    return &links[chan];
+}
+
+void init_mavlink_links(void) {
+    init_pool(&frame_pool);
+    for(uint8_t i = 0; i < MAVLINK_NUM_LINKS; i++) {
+        chMtxObjectInit(&links[i].mtx);
+        chTMObjectInit(&links[i].tx_tm);
+    }
+
+    /* UART1 */
+    palSetPadMode(GPIOA, 9, PAL_MODE_STM32_ALTERNATE_PUSHPULL);
+    palSetPadMode(GPIOA, 10, PAL_MODE_INPUT);
+    uart_dma_start(&UDD1, &uart1_config);
+    links[MAVLINK_COMM_UART1].udp = &UDD1;
+
+#if MAVLINK_USE_USART3
+    /* UART3, pins remapped to PC10/PC11 in boardInit() */
+    palSetPadMode(GPIOC, 10, PAL_MODE_STM32_ALTERNATE_PUSHPULL);
+    palSetPadMode(GPIOC, 11, PAL_MODE_INPUT);
+    uart_dma_start(&UDD3, &uart3_config);
+    links[MAVLINK_COMM_UART3].udp = &UDD3;
+#endif
+}
+
+// Serializes senders on a link, see mavlink_bridge.h
+void mavlink_lock(mavlink_channel_t chan) {
+    mavlink_link_t *link = get_link(chan);
+    if(link != NULL)
+        chMtxLock(&link->mtx);
+}
+
+void mavlink_unlock(mavlink_channel_t chan) {
+    mavlink_link_t *link = get_link(chan);
+    if(link != NULL)
+        chMtxUnlock(&link->mtx);
+}
+
+/*
+ * RX events only wake the receiving thread, the ring is drained from
+ * thread context with mavlink_rx_getc().
+ */
+static void rx_cb(uart_dma_t *udp, uint8_t events) {
+    (void) events;
+    for(uint8_t i = 0; i < MAVLINK_NUM_LINKS; i++) {
+        if(links[i].udp == udp && links[i].rx_thread != NULL) {
+            chSysLockFromISR();
+            chEvtSignalI(links[i].rx_thread, EVENT_MASK(i));
+            chSysUnlockFromISR();
+        }
+    }
+}
+
+/*
+ * Thread to be woken with EVENT_MASK(chan) when data arrives on chan,
+ * must be called by that thread.
+ */
+void mavlink_rx_attach(mavlink_channel_t chan) {
+    mavlink_link_t *link = get_link(chan);
+    if(link == NULL)
+        return;
+    link->rx_thread = chThdGetSelfX();
+}
+
+// Next received byte or -1, only one thread may read a channel
+int16_t mavlink_rx_getc(mavlink_channel_t chan) {
+    mavlink_link_t *link = get_link(chan);
+    if(link == NULL)
+        return -1;
+    return uart_dma_getc(link->udp);
+}
+
+uint32_t mavlink_rx_errors(mavlink_channel_t chan) {
+    mavlink_link_t *link = get_link(chan);
+    if(link == NULL)
+        return 0;
+    return link->udp->rx_errors;
+}
+
+static void link_start(mavlink_link_t *link, uint16_t length) {
+    chDbgAssert(link->mtx.m_owner == chThdGetSelfX(), "link not locked");
+    chTMStartMeasurementX(&link->tx_tm);
+    link->pos = 0;
+    if(length > MAVLINK_MAX_PACKET_LEN)
+        link->frame = NULL;
+    else
+        link->frame = uart_dma_tx_reserve(link->udp);
+}
+
+static void link_bytes(mavlink_link_t *link, const uint8_t *buf, uint16_t len) {
+    if(link->frame == NULL)
+        return;
+    if(link->pos + len > MAVLINK_MAX_PACKET_LEN)
+        len = MAVLINK_MAX_PACKET_LEN - link->pos;
+    memcpy(&link->frame[link->pos], buf, len);
+    link->pos += len;
+}
+
+static void link_end(mavlink_link_t *link) {
+    if(link->frame != NULL)
+        uart_dma_tx_commit(link->udp, link->frame, link->pos);
+    link->frame = NULL;
+    chTMStopMeasurementX(&link->tx_tm);
+}
+
+void mavlink_tx_start(mavlink_channel_t chan, uint16_t length) {
+    mavlink_link_t *link = get_link(chan);
+    if(link != NULL)
+        link_start(link, length);
+}
+
+void mavlink_tx_bytes(mavlink_channel_t chan, const uint8_t *buf, uint16_t len) {
+    mavlink_link_t *link = get_link(chan);
+    if(link != NULL)
+        link_bytes(link, buf, len);
+}
+
+void mavlink_tx_end(mavlink_channel_t chan, uint16_t length) {
+    (void) length;
+    mavlink_link_t *link = get_link(chan);
+    if(link != NULL)
+        link_end(link);
+}
+
+bool mavlink_link_active(mavlink_channel_t chan) {
+    return get_link(chan) != NULL;
+}
+
+/*
+ * Broadcasts are sent once per link so every link keeps its own
+ * contiguous sequence numbers.
+ */
+void mavlink_get_links(mavlink_links_t *list) {
+    list->n = 0;
+    for(uint8_t i = 0; i < MAVLINK_NUM_LINKS; i++) {
+        if(link_active(&links[i]))
+            list->chan[list->n++] = (mavlink_channel_t)i;
+    }
+}
+
+// DMA TX statistics of a link
+const uart_dma_tx_stats_t *mavlink_tx_stats(mavlink_channel_t chan) {
+    mavlink_link_t *link = get_link(chan);
+    if(link == NULL)
+        return NULL;
+    return &link->udp->tx_stats;
+}
+
+const time_measurement_t *mavlink_tx_time(mavlink_channel_t chan) {
+    mavlink_link_t *link = get_link(chan);
+    if(link == NULL)
+        return NULL;
+    return &link->tx_tm;
+}
+
+uint32_t mavlink_tx_dropped(mavlink_channel_t chan) {
+    mavlink_link_t *link = get_link(chan);
+    if(link == NULL)
+        return 0;
+    return link->udp->tx_stats.dropped;
+}
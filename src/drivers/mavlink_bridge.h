@@ -2,25 +2,88 @@
 #define SRC_MAVLINK_BRIDGE_H_
 
 #define MAVLINK_USE_CONVENIENCE_FUNCTIONS
+/*
+ * The helpers are static inline, so by default every file sending MAVLink
+ * would keep its own channel status and sequence counters. The bridge
+ * holds the one copy instead.
+ */
+#define MAVLINK_EXTERNAL_RX_STATUS
 
 #include "../mavlink_types.h"
 #include "ch.h"
 #include "hal.h"
 
+#include "uart_dma.h"
+
+#define MAVLINK_BAUD            115200
+#define MAVLINK_TX_FRAMES       4       // TX ring depth per link
+// TX frames shared by the rings of all links
+#ifndef MAVLINK_TX_POOL_FRAMES
+#define MAVLINK_TX_POOL_FRAMES  (MAVLINK_TX_FRAMES * MAVLINK_NUM_LINKS)
+#endif
+// RX DMA ring per link, at 921600 baud 512 bytes is 5.5 ms of data
+#ifndef MAVLINK_RX_BUF_SIZE
+#define MAVLINK_RX_BUF_SIZE     512
+#endif
+
+/*
+ * Links, each with its own sequence counter. The board has no USB
+ * device stack configured (HAL_USE_USB is off), so there is no USB link.
+ */
+#define MAVLINK_COMM_UART1      MAVLINK_COMM_0
+#define MAVLINK_COMM_UART3      MAVLINK_COMM_1
+#define MAVLINK_NUM_LINKS       2
+// Addresses all links in the telemetry queue, never sent on
+#define MAVLINK_COMM_ALL        MAVLINK_COMM_2
+
+// Second radio on USART3, needs UART_DMA_USE_USART3
+#ifndef MAVLINK_USE_USART3
+#define MAVLINK_USE_USART3      TRUE
+#endif
+#if MAVLINK_USE_USART3 && !UART_DMA_USE_USART3
+#error "MAVLINK_USE_USART3 requires UART_DMA_USE_USART3"
+#endif
+#if MAVLINK_USE_USART3 && SBUS_ENABLED
+#error "USART3 is used by SBUS, build with MAVLINK_USE_USART3 FALSE"
+#endif
+
+extern mavlink_system_t mavlink_system;
+extern mavlink_status_t m_mavlink_status[MAVLINK_COMM_NUM_BUFFERS];
 
-mavlink_system_t mavlink_system = {1, 100}; /* SysID, CompID */
+// Active links, a broadcast sends the message on each of them
+typedef struct {
+    uint8_t n;
+    mavlink_channel_t chan[MAVLINK_NUM_LINKS];
+} mavlink_links_t;
 
-/**
- * @brief Send one char (uint8_t) over a comm channel
+/*
+ * The MAVLink helpers serialize a message as header, payload and checksum
+ * between MAVLINK_START_UART_SEND and MAVLINK_END_UART_SEND. The pieces are
+ * written straight into a reserved frame of the link's DMA TX ring, which
+ * is queued as one DMA transfer at the end. Sending never waits for the
+ * UART, if the ring is full the message is dropped.
  *
- * @param chan MAVLink channel to use
- * @param ch Character to send
+ * The helpers take the link sequence number before MAVLINK_START_UART_SEND,
+ * so every mavlink_msg_*_send() and _mavlink_resend_uart() call must be
+ * made between mavlink_lock() and mavlink_unlock() of its link.
  */
-static void comm_send_ch(mavlink_channel_t chan, uint8_t ch) {
-    if(chan == MAVLINK_COMM_0) { /* UART1 */
-        chnPutTimeout(&SD1, ch, MS2ST(5));
-    }
-}
+#define MAVLINK_START_UART_SEND(chan, length)   mavlink_tx_start(chan, length)
+#define MAVLINK_SEND_UART_BYTES(chan, buf, len) mavlink_tx_bytes(chan, buf, len)
+#define MAVLINK_END_UART_SEND(chan, length)     mavlink_tx_end(chan, length)
 
+void init_mavlink_links(void);
+void mavlink_lock(mavlink_channel_t chan);
+void mavlink_unlock(mavlink_channel_t chan);
+bool mavlink_link_active(mavlink_channel_t chan);
+void mavlink_get_links(mavlink_links_t *links);
+void mavlink_rx_attach(mavlink_channel_t chan);
+int16_t mavlink_rx_getc(mavlink_channel_t chan);
+uint32_t mavlink_rx_errors(mavlink_channel_t chan);
+void mavlink_tx_start(mavlink_channel_t chan, uint16_t length);
+void mavlink_tx_bytes(mavlink_channel_t chan, const uint8_t *buf, uint16_t len);
+void mavlink_tx_end(mavlink_channel_t chan, uint16_t length);
+uint32_t mavlink_tx_dropped(mavlink_channel_t chan);
+const uart_dma_tx_stats_t *mavlink_tx_stats(mavlink_channel_t chan);
+const time_measurement_t *mavlink_tx_time(mavlink_channel_t chan);
 
 #endif /* SRC_MAVLINK_BRIDGE_H_ */
@@ -0,0 +1,145 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "rc_check.h"
+#include "rc_decode.h"
+
+#define W(t, v)     { (t), (v), RC_EVT_WIDTH, 0 }
+#define P(t, v)     { (t), (v), RC_EVT_PERIOD, 0 }
+#define TIMEOUT(t)  { (t), 0, RC_EVT_TIMEOUT, 0 }
+#define LEN(a)      (sizeof(a) / sizeof((a)[0]))
+
+typedef struct {
+    uint16_t frames;
+    uint16_t lost;
+    uint8_t num_channels;       // of the last frame
+    uint16_t channels[RC_MAX_CHANNELS];
+    uint16_t ch0_max;
+} rc_check_result_t;
+
+typedef struct {
+    const char *name;
+    uint8_t mode;
+    const rc_filter_config_t *cfg;
+    const rc_trace_event_t *trace;
+    uint8_t len;
+    rc_check_result_t expect;   // ch0_max 0, don't care
+} rc_check_t;
+
+static const rc_filter_config_t cfg_off = { 0, 0, 0, 0 };
+static const rc_filter_config_t cfg_median = { 1, 0, 0, 0 };
+static const rc_filter_config_t cfg_rate = { 0, 50, 0, 0 };
+static const rc_filter_config_t cfg_expo = { 0, 0, 0, 50 };
+
+// PWM, 50 Hz with a few us of jitter, all stages off passes through
+static const rc_trace_event_t pwm_jitter[] = {
+    P(0, 20000), W(1497, 1497),
+    P(20003, 20003), W(21506, 1503),
+    P(39998, 19995), W(41897, 1899),
+};
+
+// single sample spike, the median removes it
+static const rc_trace_event_t pwm_spike[] = {
+    W(0, 1500), W(20000, 1500), W(40000, 1900), W(60000, 1500), W(80000, 1500),
+};
+
+// full deflection step, limited to 50 us per sample
+static const rc_trace_event_t pwm_step[] = {
+    W(0, 1500), W(20000, 1800), W(40000, 1800),
+};
+
+// signal goes away
+static const rc_trace_event_t pwm_dropout[] = {
+    W(0, 1500), TIMEOUT(220000),
+};
+
+// PPM-sum, sync gap, 8 channels, sync gap
+static const rc_trace_event_t ppm_frame[] = {
+    P(0, 5000),
+    P(1000, 1000), P(2100, 1100), P(3300, 1200), P(4600, 1300),
+    P(6000, 1400), P(7500, 1500), P(9100, 1600), P(10800, 1700),
+    P(15800, 5000),
+};
+
+// out of range period drops the frame until the next sync
+static const rc_trace_event_t ppm_glitch[] = {
+    P(0, 5000), P(1000, 1000), P(2100, 1100), P(2600, 500), P(3900, 1300),
+    P(5300, 1400), P(10300, 5000),
+    P(11300, 1000), P(12400, 1100), P(13600, 1200), P(14900, 1300),
+    P(19900, 5000),
+};
+
+// pulses beyond the stick range pass unfiltered, expo limits them
+static const rc_trace_event_t ppm_wide[] = {
+    P(0, 5000), P(2100, 2100), P(3000, 900), P(4500, 1500), P(6000, 1500),
+    P(11000, 5000),
+};
+
+static const rc_check_t checks[] = {
+    { "pwm_jitter", RC_INPUT_PWM, &cfg_off, pwm_jitter, LEN(pwm_jitter),
+      { 3, 0, 1, { 1899 }, 1899 } },
+    { "pwm_spike", RC_INPUT_PWM, &cfg_median, pwm_spike, LEN(pwm_spike),
+      { 5, 0, 1, { 1500 }, 1500 } },
+    { "pwm_step", RC_INPUT_PWM, &cfg_rate, pwm_step, LEN(pwm_step),
+      { 3, 0, 1, { 1600 }, 1600 } },
+    { "pwm_dropout", RC_INPUT_PWM, NULL, pwm_dropout, LEN(pwm_dropout),
+      { 1, 1, 0, { 0 }, 1500 } },
+    { "ppm_frame", RC_INPUT_PPM, NULL, ppm_frame, LEN(ppm_frame),
+      { 1, 0, 8, { 1000, 1100, 1200, 1300, 1400, 1500, 1600, 1700 }, 0 } },
+    { "ppm_glitch", RC_INPUT_PPM, &cfg_off, ppm_glitch, LEN(ppm_glitch),
+      { 1, 0, 4, { 1000, 1100, 1200, 1300 }, 0 } },
+    { "ppm_wide", RC_INPUT_PPM, &cfg_off, ppm_wide, LEN(ppm_wide),
+      { 1, 0, 4, { 2100, 900, 1500, 1500 }, 0 } },
+    { "ppm_wide_expo", RC_INPUT_PPM, &cfg_expo, ppm_wide, LEN(ppm_wide),
+      { 1, 0, 4, { 2000, 1000, 1500, 1500 }, 0 } },
+};
+
+static void run(const rc_check_t *c, rc_check_result_t *r) {
+    static rc_decoder_t dec;
+
+    memset(r, 0, sizeof(*r));
+    rc_decode_init(&dec, c->mode, c->cfg);
+    for(uint8_t i = 0; i < c->len; i++) {
+        uint8_t res = rc_decode_event(&dec, &c->trace[i]);
+        if(res & RC_DECODE_FRAME) {
+            r->frames++;
+            r->num_channels = dec.num_channels;
+            memcpy(r->channels, dec.channels, sizeof(r->channels));
+            if(dec.channels[0] > r->ch0_max)
+                r->ch0_max = dec.channels[0];
+        }
+        if(res & RC_DECODE_LOST) {
+            r->lost++;
+            r->num_channels = 0;
+        }
+    }
+}
+
+static bool matches(const rc_check_result_t *r, const rc_check_result_t *e) {
+    if(r->frames != e->frames || r->lost != e->lost || r->num_channels != e->num_channels)
+        return false;
+    if(e->ch0_max != 0 && r->ch0_max != e->ch0_max)
+        return false;
+    return memcmp(r->channels, e->channels, e->num_channels * sizeof(uint16_t)) == 0;
+}
+
+uint8_t rc_check_count(void) {
+    return LEN(checks);
+}
+
+const char *rc_check_name(uint8_t i) {
+    return i < LEN(checks) ? checks[i].name : NULL;
+}
+
+uint32_t rc_check_run(void) {
+    rc_check_result_t r;
+    uint32_t failed = 0;
+
+    for(uint8_t i = 0; i < LEN(checks); i++) {
+        run(&checks[i], &r);
+        if(!matches(&r, &checks[i].expect))
+            failed |= 1UL << i;
+    }
+    return failed;
+}
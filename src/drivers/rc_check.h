@@ -0,0 +1,23 @@
+#ifndef SRC_DRIVERS_RC_CHECK_H_
+#define SRC_DRIVERS_RC_CHECK_H_
+
+#include <stdint.h>
+
+/*
+ * Trace driven checks of the RC decoder and filter pipeline. Synthetic
+ * edge traces (jitter, glitches, dropouts, out of range pulses) are run
+ * through a private decoder and the decoded frames compared with the
+ * expected ones. Only depends on rc_decode and rc_filter, so the same
+ * file links into a host program. On the target it is built with
+ * RC_CHECK and run with COMMAND_LONG MAV_CMD_USER_3.
+ */
+#ifndef RC_CHECK
+#define RC_CHECK            0
+#endif
+
+uint8_t rc_check_count(void);
+const char *rc_check_name(uint8_t i);
+// Runs all checks, returns a bit per failed check
+uint32_t rc_check_run(void);
+
+#endif /* SRC_DRIVERS_RC_CHECK_H_ */
@@ -0,0 +1,85 @@
+#include <string.h>
+
+#include "rc_decode.h"
+
+#define RC_MAX 1930
+#define RC_MIN 1012
+
+// PPM-sum limits, anything longer than RC_PPM_SYNC_MIN is the sync gap
+#define RC_PPM_MAX 2200
+#define RC_PPM_MIN 800
+#define RC_PPM_SYNC_MIN 3000
+#define RC_PPM_MIN_CHANNELS 4
+
+#define RC_FRAME_INVALID 0xFF
+
+void rc_decode_init(rc_decoder_t *dec, uint8_t mode, const rc_filter_config_t *filter_cfg) {
+    memset(dec, 0, sizeof(rc_decoder_t));
+    dec->filter_cfg = filter_cfg;
+    dec->mode = mode;
+    dec->ppm_channel = RC_FRAME_INVALID;
+    rc_filter_reset(dec->filter, RC_MAX_CHANNELS);
+}
+
+static uint8_t decode_width(rc_decoder_t *dec, uint16_t width) {
+    if(dec->mode != RC_INPUT_PWM)
+        return 0;
+    if(width >= RC_MAX || width <= RC_MIN)
+        return RC_DECODE_ALIVE;
+
+    width = rc_filter_apply(dec->filter_cfg, &dec->filter[0], width);
+    dec->sample_width = width;
+    dec->sample_period = dec->last_period;
+    dec->channels[0] = width;
+    dec->num_channels = 1;
+    return RC_DECODE_SAMPLE | RC_DECODE_FRAME | RC_DECODE_ALIVE;
+}
+
+static uint8_t decode_period(rc_decoder_t *dec, uint16_t period) {
+    uint8_t res = 0;
+
+    if(dec->mode != RC_INPUT_PPM) {
+        // the width only is published, the period goes with the next sample
+        dec->last_period = period;
+        return 0;
+    }
+
+    // in PPM-sum every period between active edges is one channel
+    if(period > RC_PPM_SYNC_MIN) {
+        if(dec->ppm_channel != RC_FRAME_INVALID && dec->ppm_channel >= RC_PPM_MIN_CHANNELS) {
+            dec->num_channels = dec->ppm_channel;
+            res = RC_DECODE_FRAME | RC_DECODE_ALIVE;
+        }
+        dec->ppm_channel = 0;
+    } else if(dec->ppm_channel < RC_MAX_CHANNELS) {
+        if(period >= RC_PPM_MIN && period <= RC_PPM_MAX) {
+            dec->sample_width = period;
+            dec->sample_period = period;
+            dec->channels[dec->ppm_channel] = rc_filter_apply(dec->filter_cfg,
+                    &dec->filter[dec->ppm_channel], period);
+            dec->ppm_channel++;
+            res = RC_DECODE_SAMPLE;
+        } else {
+            dec->ppm_channel = RC_FRAME_INVALID; // glitch, drop frame until next sync
+        }
+    }
+    return res;
+}
+
+uint8_t rc_decode_event(rc_decoder_t *dec, const rc_trace_event_t *ev) {
+    switch(ev->type) {
+    case RC_EVT_WIDTH:
+        return decode_width(dec, ev->value);
+    case RC_EVT_PERIOD:
+        return decode_period(dec, ev->value);
+    case RC_EVT_TIMEOUT:
+        dec->sample_width = 0;
+        dec->sample_period = 0;
+        dec->num_channels = 0;
+        dec->ppm_channel = RC_FRAME_INVALID;
+        rc_filter_reset(dec->filter, RC_MAX_CHANNELS);
+        return RC_DECODE_LOST | RC_DECODE_SAMPLE;
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef SRC_DRIVERS_RC_DECODE_H_
+#define SRC_DRIVERS_RC_DECODE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rc_filter.h"
+
+// Input decoding, single PWM pulse or PPM-sum
+#define RC_INPUT_PWM        0
+#define RC_INPUT_PPM        1
+
+#define RC_MAX_CHANNELS     12
+
+#define RC_TIMEOUT_US       200000
+
+// ICU event types
+#define RC_EVT_WIDTH        0
+#define RC_EVT_PERIOD       1
+#define RC_EVT_TIMEOUT      2
+
+/*
+ * One input event as seen by the decoder. Recorded traces are arrays of
+ * these, 8 bytes each, little endian, so a recording can be dumped and
+ * replayed byte for byte.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t time_us;           // time of the capture
+    uint16_t value;             // width or period in us, 0 for timeout
+    uint8_t type;               // RC_EVT_*
+    uint8_t reserved;
+} rc_trace_event_t;
+
+// decoder results, or'ed together
+#define RC_DECODE_SAMPLE    0x01    // sample_width/sample_period updated
+#define RC_DECODE_FRAME     0x02    // channels[0..num_channels) is a complete frame
+#define RC_DECODE_ALIVE     0x04    // valid signal, restart the timeout
+#define RC_DECODE_LOST      0x08    // signal timed out
+
+/*
+ * Decoder state. Has no RTOS or hardware dependencies, the ICU callbacks
+ * and the trace replay feed the same code.
+ */
+typedef struct {
+    const rc_filter_config_t *filter_cfg;   // NULL, no filtering
+    uint8_t mode;               // RC_INPUT_PWM or RC_INPUT_PPM
+    uint8_t ppm_channel;
+    uint8_t num_channels;
+    uint16_t last_period;
+    uint16_t sample_width;
+    uint16_t sample_period;
+    uint16_t channels[RC_MAX_CHANNELS];
+    rc_filter_state_t filter[RC_MAX_CHANNELS];
+} rc_decoder_t;
+
+void rc_decode_init(rc_decoder_t *dec, uint8_t mode, const rc_filter_config_t *filter_cfg);
+uint8_t rc_decode_event(rc_decoder_t *dec, const rc_trace_event_t *ev);
+
+#endif /* SRC_DRIVERS_RC_DECODE_H_ */
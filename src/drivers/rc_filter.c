@@ -0,0 +1,80 @@
+#include <stddef.h>
+
+#include "rc_filter.h"
+
+static inline int16_t median3(int16_t a, int16_t b, int16_t c) {
+    int16_t lo = a < b ? a : b;
+    int16_t hi = a < b ? b : a;
+    if(c < lo)
+        return lo;
+    if(c > hi)
+        return hi;
+    return c;
+}
+
+// Remove deadband around center and stretch the rest back to full range
+static inline int32_t deadband(int32_t x, int32_t db) {
+    if(x > db)
+        return (x - db) * RC_FILTER_RANGE / (RC_FILTER_RANGE - db);
+    if(x < -db)
+        return (x + db) * RC_FILTER_RANGE / (RC_FILTER_RANGE - db);
+    return 0;
+}
+
+// out = x * (1 - e) + e * x^3 / R^2, e in percent
+static inline int32_t expo(int32_t x, int32_t e) {
+    int32_t cube = (x * x / RC_FILTER_RANGE) * x / RC_FILTER_RANGE;
+    return (x * (100 - e) + cube * e) / 100;
+}
+
+uint16_t rc_filter_apply(const rc_filter_config_t *cfg, rc_filter_state_t *s, uint16_t width) {
+    int16_t in = width;
+    int16_t v;
+    bool shape;
+
+    if(cfg == NULL)
+        return width;
+    if(!s->valid) {
+        s->hist[0] = s->hist[1] = s->out = in;
+        s->valid = true;
+    }
+
+    // median of 3, rejects single sample glitches
+    v = cfg->median ? median3(in, s->hist[0], s->hist[1]) : in;
+    s->hist[1] = s->hist[0];
+    s->hist[0] = in;
+
+    // rate limiter, max change per sample
+    if(cfg->rate_max > 0) {
+        if(v > s->out + cfg->rate_max)
+            v = s->out + cfg->rate_max;
+        else if(v < s->out - cfg->rate_max)
+            v = s->out - cfg->rate_max;
+    }
+    s->out = v;
+
+    // deadband and expo work on the normalized stick range
+    shape = (cfg->deadband > 0 && cfg->deadband < RC_FILTER_RANGE) ||
+            (cfg->expo > 0 && cfg->expo <= 100);
+    if(!shape)
+        return v;
+
+    int32_t x = v - RC_FILTER_CENTER;
+    if(x > RC_FILTER_RANGE)
+        x = RC_FILTER_RANGE;
+    else if(x < -RC_FILTER_RANGE)
+        x = -RC_FILTER_RANGE;
+
+    if(cfg->deadband > 0 && cfg->deadband < RC_FILTER_RANGE)
+        x = deadband(x, cfg->deadband);
+    if(cfg->expo > 0 && cfg->expo <= 100)
+        x = expo(x, cfg->expo);
+
+    return RC_FILTER_CENTER + x;
+}
+
+// Forget history, used when the signal is lost
+void rc_filter_reset(rc_filter_state_t *state, uint8_t n) {
+    for(uint8_t i = 0; i < n; i++)
+        state[i].valid = false;
+}
@@ -0,0 +1,37 @@
+#ifndef SRC_DRIVERS_RC_FILTER_H_
+#define SRC_DRIVERS_RC_FILTER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RC_FILTER_CENTER    1500
+#define RC_FILTER_RANGE     500     // us from center to full deflection
+
+/*
+ * Per channel RC filter pipeline, run on every sample before it is
+ * published: median of 3, rate limiter, deadband, expo. Integer only and
+ * constant time. The median delays steps by one sample, the other stages
+ * add no delay. Zero disables a stage, with all of them disabled the
+ * input passes through unchanged. Only deadband and expo limit the
+ * output to center +-RC_FILTER_RANGE.
+ *
+ * No RTOS or HAL dependencies, the firmware passes the RC_FILT_MEDIAN,
+ * RC_RATE_MAX, RC_DEADBAND and RC_EXPO parameters as the config.
+ */
+typedef struct {
+    int16_t median;         // != 0 enables the median of 3
+    int16_t rate_max;       // max change per sample in us
+    int16_t deadband;       // us around center
+    int16_t expo;           // 0-100%
+} rc_filter_config_t;
+
+typedef struct {
+    int16_t hist[2];        // previous two inputs
+    int16_t out;            // previous output
+    bool valid;
+} rc_filter_state_t;
+
+uint16_t rc_filter_apply(const rc_filter_config_t *cfg, rc_filter_state_t *s, uint16_t width);
+void rc_filter_reset(rc_filter_state_t *state, uint8_t n);
+
+#endif /* SRC_DRIVERS_RC_FILTER_H_ */
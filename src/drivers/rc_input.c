@@ -1,40 +1,140 @@
+#include <string.h>
+
 #include "ch.h"
 #include "hal.h"
 
 #include "rc_input.h"
-
-#define RC_MAX 1930
-#define RC_MIN 1012
+#include "rc_decode.h"
+#include "parameters_d.h"
+#include "seqlock.h"
+#include "topic.h"
+#include "led.h"
+#include "timebase.h"
 
 static virtual_timer_t rc_timeout;
 
-icucnt_t last_width, last_period;
 static bool init = false;
 
+static rc_decoder_t decoder;
+
+// Latest pulse. Written from the ICU ISR and the timeout callback, both
+// with the kernel lock held.
+static rc_sample_t sample;
+static seqlock_t sample_lock = SEQLOCK_INIT;
+static rc_latency_stats_t latency;
+
+/*
+ * Double buffered frames, the decoded frame is copied into
+ * frames[write_idx] and published by flipping the index.
+ */
+static rc_frame_t frames[2];
+static uint8_t published_idx = 0;
+static seqlock_t frame_lock = SEQLOCK_INIT;
+static uint8_t write_idx = 1;
+
+// Edge recorder
+static rc_trace_event_t *trace_buf = NULL;
+static size_t trace_size = 0;
+static volatile size_t trace_len = 0;
+static rtcnt_t trace_last_cnt;
+static uint32_t trace_us = 0;
+
+TOPIC_DEF(rc_frame_topic, "rc_frame", rc_frame_t);
+TOPIC_DEF(rc_sample_topic, "rc_sample", rc_sample_t);
+
+static void rc_timeout_cb(void *arg);
+
+// called with the kernel lock held
+static void publish_frame(const rc_decoder_t *dec) {
+    memcpy(frames[write_idx].channels, dec->channels, sizeof(dec->channels));
+    frames[write_idx].num_channels = dec->num_channels;
+    frames[write_idx].timestamp = chVTGetSystemTimeX();
+    seqlock_write_begin(&frame_lock);
+    published_idx = write_idx;
+    seqlock_write_end(&frame_lock);
+    topic_publishI(&rc_frame_topic, &frames[write_idx]);
+    write_idx ^= 1;
+}
+
+// called with the kernel lock held
+static void publish_sample(uint16_t width, uint16_t period) {
+    seqlock_write_begin(&sample_lock);
+    sample.width = width;
+    sample.period = period;
+    sample.timestamp = chSysGetRealtimeCounterX();
+    sample.seq++;
+    seqlock_write_end(&sample_lock);
+    topic_publishI(&rc_sample_topic, &sample);
+}
+
+// Microseconds since the recorder was started, called with the kernel lock held
+static uint32_t trace_time(void) {
+    uint32_t us = (chSysGetRealtimeCounterX() - trace_last_cnt) / (STM32_HCLK / 1000000);
+    // keep the sub microsecond remainder for the next call
+    trace_last_cnt += us * (STM32_HCLK / 1000000);
+    trace_us += us;
+    return trace_us;
+}
+
+/*
+ * Runs one ICU event through the decoder and publishes the result.
+ * Called with the kernel lock held.
+ */
+static void handle_event(uint8_t type, uint16_t value) {
+    rc_trace_event_t ev;
+    uint8_t res;
+
+    ev.time_us = trace_buf != NULL ? trace_time() : 0;
+    ev.value = value;
+    ev.type = type;
+    ev.reserved = 0;
+    if(trace_buf != NULL && trace_len < trace_size)
+        trace_buf[trace_len++] = ev;
+
+    res = rc_decode_event(&decoder, &ev);
+    if(res & RC_DECODE_SAMPLE)
+        publish_sample(decoder.sample_width, decoder.sample_period);
+    if(res & RC_DECODE_FRAME)
+        publish_frame(&decoder);
+    if(res & RC_DECODE_LOST) {
+        led_set_stateI(LED_STATE_RC_LOST, true);
+        seqlock_write_begin(&frame_lock);
+        frames[published_idx].num_channels = 0;
+        seqlock_write_end(&frame_lock);
+        topic_publishI(&rc_frame_topic, &frames[published_idx]);
+    }
+    if(res & RC_DECODE_ALIVE) {
+        led_set_stateI(LED_STATE_RC_LOST, false);
+        /* Set timeout virtual timer if we don't get more callback
+        * int given time it will set rpm to 0*/
+        chVTSetI(&rc_timeout, TIMEBASE_US2ST(RC_TIMEOUT_US), rc_timeout_cb, NULL);
+    }
+}
+
 /*
  * RC timeout timer callback.
  */
 static void rc_timeout_cb(void *arg) {
     (void) arg;
-    last_width = 0;
+    chSysLockFromISR();
+    handle_event(RC_EVT_TIMEOUT, 0);
+    chSysUnlockFromISR();
 }
 
 static void icuwidthcb(ICUDriver *icup) {
     uint16_t width = icuGetWidthX(icup);
 
-    if(width < RC_MAX && width > RC_MIN)
-        last_width = width;
-
-    /* Set timeout virtual timer if we don't get more callback
-    * int given time it will set rpm to 0*/
     chSysLockFromISR();
-    chVTSetI(&rc_timeout, MS2ST(200), rc_timeout_cb, NULL);
+    handle_event(RC_EVT_WIDTH, width);
     chSysUnlockFromISR();
 }
 
 static void icuperiodcb(ICUDriver *icup) {
+    uint16_t period = icuGetPeriodX(icup);
 
-  last_period = icuGetPeriodX(icup);
+    chSysLockFromISR();
+    handle_event(RC_EVT_PERIOD, period);
+    chSysUnlockFromISR();
 }
 
 static ICUConfig icucfg = {
@@ -48,20 +148,144 @@ static ICUConfig icucfg = {
 };
 
 void init_rc_input(void) {
+    rc_decode_init(&decoder, RC_INPUT_MODE, &rc_filter_cfg);
+
+    /* RPM timeout timer initialization, before the first pulse can arm it.*/
+    chVTObjectInit(&rc_timeout);
+    // lost until the decoder sees a valid pulse, the timeout only runs after one
+    led_set_state(LED_STATE_RC_LOST, true);
+
     icuStart(&ICUD8, &icucfg);
     icuStartCapture(&ICUD8);
     icuEnableNotifications(&ICUD8);
 
-    /* RPM timeout timer initialization.*/
-    chVTObjectInit(&rc_timeout);
-
     init = true;
 
 }
 
-uint16_t get_rc_input(void) {
+// Copy of the latest frame, false if there is no valid frame
+bool get_rc_frame(rc_frame_t *frame) {
+    uint32_t seq;
     if(!init)
+        return false;
+    do {
+        seq = seqlock_read_begin(&frame_lock);
+        memcpy(frame, &frames[published_idx], sizeof(rc_frame_t));
+    } while(seqlock_read_retry(&frame_lock, seq));
+    return frame->num_channels > 0;
+}
+
+// Consistent copy of the latest pulse, doesn't disable interrupts
+void rc_get_sample(rc_sample_t *s) {
+    uint32_t seq;
+    do {
+        seq = seqlock_read_begin(&sample_lock);
+        *s = sample;
+    } while(seqlock_read_retry(&sample_lock, seq));
+}
+
+/*
+ * Latest pulse for a consumer keeping track of the last sample it used.
+ * Returns true if the sample is newer than *last_seq and accounts its
+ * receive to consume latency.
+ */
+bool rc_consume_sample(rc_sample_t *s, uint32_t *last_seq) {
+    rc_get_sample(s);
+    if(s->seq == *last_seq)
+        return false;
+    *last_seq = s->seq;
+
+    uint32_t us = RTC2US(STM32_HCLK, chSysGetRealtimeCounterX() - s->timestamp);
+    if(latency.count == 0 || us < latency.min_us)
+        latency.min_us = us;
+    if(us > latency.max_us)
+        latency.max_us = us;
+    if(latency.count == 0)
+        latency.avg_us = us;
+    else
+        latency.avg_us = latency.avg_us - latency.avg_us / 16 + us / 16;
+    latency.count++;
+    return true;
+}
+
+const rc_latency_stats_t *rc_get_latency_stats(void) {
+    return &latency;
+}
+
+uint16_t get_rc_channel(uint8_t ch) {
+    rc_frame_t frame;
+    if(!get_rc_frame(&frame) || ch >= frame.num_channels)
         return 0;
-    return last_width;
+    return frame.channels[ch];
+}
+
+uint8_t get_rc_channel_count(void) {
+    rc_frame_t frame;
+    if(!get_rc_frame(&frame))
+        return 0;
+    return frame.num_channels;
+}
+
+uint16_t get_rc_input(void) {
+    return get_rc_channel(0);
+}
+
+/*
+ * Record every ICU event into buf until it is full. The buffer can be
+ * dumped as is and fed back to rc_input_replay().
+ */
+void rc_trace_start(rc_trace_event_t *buf, size_t n) {
+    chSysLock();
+    trace_len = 0;
+    trace_size = n;
+    trace_us = 0;
+    trace_last_cnt = chSysGetRealtimeCounterX();
+    trace_buf = buf;
+    chSysUnlock();
+}
+
+// Events recorded so far, the recorder stops by itself when the buffer is full
+size_t rc_trace_count(void) {
+    return trace_len;
 }
 
+// Stop recording, returns the number of recorded events
+size_t rc_trace_stop(void) {
+    chSysLock();
+    trace_buf = NULL;
+    chSysUnlock();
+    return trace_len;
+}
+
+/*
+ * Run a recorded or synthetic trace through a private decoder, the live
+ * input is not affected. filter_cfg NULL replays unfiltered. cb gets the decoder after every event that
+ * produced output so the caller can check it. A gap of more than the RC
+ * timeout between events is replayed as a timeout if the trace doesn't
+ * contain one. Decode cost per event is measured in realtime counter
+ * cycles.
+ */
+void rc_input_replay(const rc_trace_event_t *trace, size_t n, uint8_t mode,
+        const rc_filter_config_t *filter_cfg, rc_replay_cb_t cb, time_measurement_t *tm) {
+    static rc_decoder_t dec;
+    static const rc_trace_event_t timeout = { 0, 0, RC_EVT_TIMEOUT, 0 };
+    uint8_t res;
+
+    rc_decode_init(&dec, mode, filter_cfg);
+    chTMObjectInit(tm);
+    for(size_t i = 0; i < n; i++) {
+        if(i > 0 && trace[i].type != RC_EVT_TIMEOUT &&
+           trace[i].time_us - trace[i - 1].time_us >= RC_TIMEOUT_US) {
+            res = rc_decode_event(&dec, &timeout);
+            if(cb != NULL)
+                cb(&timeout, &dec, res);
+        }
+
+        chTMStartMeasurementX(tm);
+        res = rc_decode_event(&dec, &trace[i]);
+        chTMStopMeasurementX(tm);
+
+        if(res != 0 && cb != NULL)
+            cb(&trace[i], &dec, res);
+    }
+}
@@ -1,11 +1,68 @@
 #ifndef SRC_DRIVERS_RC_INPUT_H_
 #define SRC_DRIVERS_RC_INPUT_H_
 
+#include "hal.h"
+
+#include "topic.h"
+#include "rc_decode.h"
+
+// Input decoding on the TIM8 ICU
+#ifndef RC_INPUT_MODE
+#define RC_INPUT_MODE       RC_INPUT_PWM
+#endif
+
+// One decoded frame, all channel widths in us
+typedef struct {
+    uint16_t channels[RC_MAX_CHANNELS];
+    uint8_t num_channels;
+    systime_t timestamp;        // system time of the end of the frame
+} rc_frame_t;
+
+// Latest captured pulse, published lock-free from the ICU ISR
+typedef struct {
+    uint16_t width;             // us, 0 when the signal timed out
+    uint16_t period;            // us
+    rtcnt_t timestamp;          // realtime counter at capture
+    uint32_t seq;               // incremented with every new sample
+} rc_sample_t;
+
+// Receive to consume latency of samples taken with rc_consume_sample()
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t avg_us;            // running average, 1/16 weight
+} rc_latency_stats_t;
+
+/*
+ * Subscribe to these to wake on new input instead of polling. Frames are
+ * published when decoded and with num_channels 0 when the signal is
+ * lost, samples with every pulse and timeout.
+ */
+extern topic_t rc_frame_topic;
+extern topic_t rc_sample_topic;
+
 void init_rc_input(void);
 
 uint16_t get_rc_input(void);
+uint16_t get_rc_channel(uint8_t ch);
+uint8_t get_rc_channel_count(void);
+bool get_rc_frame(rc_frame_t *frame);
+
+void rc_get_sample(rc_sample_t *sample);
+bool rc_consume_sample(rc_sample_t *sample, uint32_t *last_seq);
+const rc_latency_stats_t *rc_get_latency_stats(void);
 
+// Called by rc_input_replay() with the decoder result of each event
+typedef void (*rc_replay_cb_t)(const rc_trace_event_t *ev,
+        const rc_decoder_t *dec, uint8_t res);
 
+// Edge recorder and replay
+void rc_trace_start(rc_trace_event_t *buf, size_t n);
+size_t rc_trace_count(void);
+size_t rc_trace_stop(void);
+void rc_input_replay(const rc_trace_event_t *trace, size_t n, uint8_t mode,
+        const rc_filter_config_t *filter_cfg, rc_replay_cb_t cb, time_measurement_t *tm);
 
 
 #endif /* SRC_DRIVERS_RC_INPUT_H_ */
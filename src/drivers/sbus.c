@@ -0,0 +1,137 @@
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "sbus.h"
+#include "seqlock.h"
+
+#define SBUS_HEADER         0x0F
+#define SBUS_FOOTER         0x00
+#define SBUS_FOOTER2_MASK   0xCF    // SBUS2 telemetry slot footers 0x04..0x34
+
+#define SBUS_RX_BUF_SIZE    64
+
+static uint8_t rx_buf[SBUS_RX_BUF_SIZE];
+static uint8_t frame_buf[SBUS_FRAME_SIZE];
+static uint8_t frame_pos = 0;
+
+// double buffered like rc_input frames
+static sbus_frame_t frames[2];
+static uint8_t published_idx = 0;
+static seqlock_t frame_lock = SEQLOCK_INIT;
+static bool have_frame = false;
+static uint8_t write_idx = 1;
+static bool init = false;
+
+static sbus_stats_t stats;
+
+static void sbus_rx_cb(uart_dma_t *udp, uint8_t events);
+
+static const uart_dma_config_t sbus_config = {
+    100000,
+    USART_CR1_M | USART_CR1_PCE,    // 8 data bits + even parity
+    USART_CR2_STOP_1,               // 2 stop bits
+    rx_buf,
+    SBUS_RX_BUF_SIZE,
+    sbus_rx_cb,
+    NULL,                           // receive only
+    0
+};
+
+// 16 channels of 11 bits, LSB first, in bytes 1..22
+static void decode_frame(void) {
+    sbus_frame_t *f = &frames[write_idx];
+    uint32_t bits = 0;
+    uint8_t nbits = 0;
+    uint8_t byte = 1;
+
+    for(uint8_t ch = 0; ch < SBUS_NUM_CHANNELS; ch++) {
+        while(nbits < 11) {
+            bits |= (uint32_t)frame_buf[byte++] << nbits;
+            nbits += 8;
+        }
+        f->channels[ch] = bits & 0x7FF;
+        bits >>= 11;
+        nbits -= 11;
+    }
+    f->flags = frame_buf[23] & 0x0F;
+    f->timestamp = chVTGetSystemTimeX();
+
+    stats.frames++;
+    if(f->flags & SBUS_FLAG_FRAME_LOST)
+        stats.lost_frames++;
+    if(f->flags & SBUS_FLAG_FAILSAFE)
+        stats.failsafes++;
+
+    chSysLockFromISR();
+    seqlock_write_begin(&frame_lock);
+    published_idx = write_idx;
+    seqlock_write_end(&frame_lock);
+    chSysUnlockFromISR();
+    have_frame = true;
+    write_idx ^= 1;
+}
+
+static void parse_byte(uint8_t c) {
+    if(frame_pos == 0 && c != SBUS_HEADER)
+        return;
+    frame_buf[frame_pos++] = c;
+    if(frame_pos == SBUS_FRAME_SIZE) {
+        if(c == SBUS_FOOTER || (c & SBUS_FOOTER2_MASK) == 0x04)
+            decode_frame();
+        else
+            stats.bad_frames++;
+        frame_pos = 0;
+    }
+}
+
+/*
+ * Runs in the USART/DMA IRQ. Frames are separated by a 3-7ms gap so an idle
+ * line always means a frame boundary, partial frames are dropped there.
+ */
+static void sbus_rx_cb(uart_dma_t *udp, uint8_t events) {
+    int16_t c;
+    while((c = uart_dma_getc(udp)) >= 0)
+        parse_byte(c);
+    if((events & UART_DMA_EVT_IDLE) && frame_pos != 0) {
+        stats.bad_frames++;
+        frame_pos = 0;
+    }
+}
+
+void init_sbus(void) {
+    /* USART3 RX, remapped to PC11 in boardInit() */
+    palSetPadMode(GPIOC, 11, PAL_MODE_INPUT);
+    uart_dma_start(&SBUS_UART, &sbus_config);
+    init = true;
+}
+
+bool sbus_get_frame(sbus_frame_t *frame) {
+    uint32_t seq;
+    if(!init || !have_frame)
+        return false;
+    do {
+        seq = seqlock_read_begin(&frame_lock);
+        memcpy(frame, &frames[published_idx], sizeof(sbus_frame_t));
+    } while(seqlock_read_retry(&frame_lock, seq));
+    return true;
+}
+
+uint16_t sbus_get_channel(uint8_t ch) {
+    sbus_frame_t frame;
+    if(ch >= SBUS_NUM_CHANNELS || !sbus_get_frame(&frame))
+        return 0;
+    return frame.channels[ch];
+}
+
+bool sbus_failsafe(void) {
+    sbus_frame_t frame;
+    if(!sbus_get_frame(&frame))
+        return true;
+    return (frame.flags & SBUS_FLAG_FAILSAFE) != 0;
+}
+
+const sbus_stats_t *sbus_get_stats(void) {
+    return &stats;
+}
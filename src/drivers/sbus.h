@@ -0,0 +1,50 @@
+#ifndef SRC_DRIVERS_SBUS_H_
+#define SRC_DRIVERS_SBUS_H_
+
+#include "hal.h"
+
+#include "uart_dma.h"
+
+/*
+ * Serial RC receiver input (SBUS, 100000 baud 8E2). The F103 USART can't
+ * invert RX so the line needs the usual hardware inverter.
+ * Default port is USART3 RX on PC11 (partial remap, see board.c), shared
+ * with the second MAVLink link, build with SBUS_ENABLED TRUE and
+ * MAVLINK_USE_USART3 FALSE.
+ */
+#ifndef SBUS_UART
+#define SBUS_UART           UDD3
+#endif
+
+#define SBUS_NUM_CHANNELS   16
+#define SBUS_FRAME_SIZE     25
+
+// frame flags
+#define SBUS_FLAG_CH17          0x01
+#define SBUS_FLAG_CH18          0x02
+#define SBUS_FLAG_FRAME_LOST    0x04
+#define SBUS_FLAG_FAILSAFE      0x08
+
+// raw value (172..1811) to pulse width in us (988..2012)
+#define SBUS_TO_US(raw)     ((uint16_t)(((raw) * 5) / 8 + 880))
+
+typedef struct {
+    uint16_t channels[SBUS_NUM_CHANNELS];   // raw 11 bit values
+    uint8_t flags;
+    systime_t timestamp;                    // system time of the end of the frame
+} sbus_frame_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t bad_frames;        // wrong footer or cut by idle line
+    uint32_t lost_frames;       // receiver reported frame lost
+    uint32_t failsafes;
+} sbus_stats_t;
+
+void init_sbus(void);
+bool sbus_get_frame(sbus_frame_t *frame);
+uint16_t sbus_get_channel(uint8_t ch);
+bool sbus_failsafe(void);
+const sbus_stats_t *sbus_get_stats(void);
+
+#endif /* SRC_DRIVERS_SBUS_H_ */
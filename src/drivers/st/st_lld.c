@@ -0,0 +1,54 @@
+#include "hal.h"
+
+volatile uint32_t st_lld_high = 0;
+systime_t st_lld_alarm = 0;
+
+void st_lld_init(void) {
+    rccEnableTIM2(FALSE);
+    rccResetTIM2();
+    DBGMCU->CR |= DBGMCU_CR_DBG_TIM2_STOP;
+
+    // URS first, the UG loading the prescaler must not set UIF
+    STM32_ST_TIM->CR1 = STM32_TIM_CR1_URS;
+    STM32_ST_TIM->CR2 = 0;
+    STM32_ST_TIM->PSC = (STM32_TIMCLK1 / OSAL_ST_FREQUENCY) - 1;
+    STM32_ST_TIM->ARR = 0xFFFF;
+    STM32_ST_TIM->CCMR1 = 0;
+    STM32_ST_TIM->CCR[0] = 0;
+    STM32_ST_TIM->EGR = STM32_TIM_EGR_UG;
+    STM32_ST_TIM->SR = 0;
+    STM32_ST_TIM->DIER = STM32_TIM_DIER_UIE;
+    STM32_ST_TIM->CR1 = STM32_TIM_CR1_URS | STM32_TIM_CR1_CEN;
+
+    nvicEnableVector(STM32_TIM2_NUMBER, STM32_ST_IRQ_PRIORITY);
+}
+
+/*
+ * Kernel locked. An alarm already passed when CC1 is written would only
+ * match a counter period later, the compare event is forced instead.
+ */
+void st_lld_arm(systime_t time) {
+    st_lld_alarm = time;
+    STM32_ST_TIM->CCR[0] = (uint16_t)time;
+    if((int32_t)(st_lld_get_counter() - time) >= 0)
+        STM32_ST_TIM->EGR = STM32_TIM_EGR_CC1G;
+}
+
+OSAL_IRQ_HANDLER(STM32_TIM2_HANDLER) {
+    uint32_t sr;
+
+    OSAL_IRQ_PROLOGUE();
+
+    // overflow count and flag change together for st_lld_get_counter()
+    osalSysLockFromISR();
+    sr = STM32_ST_TIM->SR & STM32_ST_TIM->DIER;
+    STM32_ST_TIM->SR = ~sr;
+    if((sr & STM32_TIM_SR_UIF) != 0)
+        st_lld_high += 0x10000;
+    if((sr & STM32_TIM_SR_CC1IF) != 0 &&
+            (int32_t)(st_lld_get_counter() - st_lld_alarm) >= 0)
+        osalOsTimerHandlerI();
+    osalSysUnlockFromISR();
+
+    OSAL_IRQ_EPILOGUE();
+}
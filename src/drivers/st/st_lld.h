@@ -0,0 +1,87 @@
+#ifndef SRC_DRIVERS_ST_ST_LLD_H_
+#define SRC_DRIVERS_ST_ST_LLD_H_
+
+#include "stm32_tim.h"
+
+/*
+ * System timer for the tickless kernel on TIM2, replacing the ChibiOS
+ * STM32 one (this directory comes first in INCDIR and the platform
+ * st_lld.c is filtered out of the build). The F1 timers are 16 bit, so
+ * the counter runs at CH_CFG_ST_FREQUENCY and its overflow interrupt
+ * counts the upper half of a 32 bit system time.
+ *
+ * The alarm compares the lower half on CC1 and is only served once the
+ * full 32 bit time is reached: an alarm more than a counter period ahead
+ * (65.5 ms at 1 MHz) takes one compare interrupt per period until due.
+ */
+#if !defined(STM32_ST_IRQ_PRIORITY)
+#define STM32_ST_IRQ_PRIORITY   8
+#endif
+
+#if STM32_ST_USE_TIMER != 2
+#error "the system timer runs on TIM2 only"
+#endif
+#if OSAL_ST_MODE != OSAL_ST_MODE_FREERUNNING
+#error "the system timer needs the tickless mode, CH_CFG_ST_TIMEDELTA > 0"
+#endif
+#if OSAL_ST_RESOLUTION != 32
+#error "the system timer extends TIM2 to 32 bit, CH_CFG_ST_RESOLUTION 32"
+#endif
+#if (STM32_TIMCLK1 % OSAL_ST_FREQUENCY) != 0
+#error "the system timer frequency doesn't divide the TIM2 clock"
+#endif
+
+#define STM32_ST_TIM            STM32_TIM2
+
+extern volatile uint32_t st_lld_high;   // upper half, in steps of 0x10000
+extern systime_t st_lld_alarm;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void st_lld_init(void);
+  void st_lld_arm(systime_t time);
+#ifdef __cplusplus
+}
+#endif
+
+/*
+ * Any context. An overflow the interrupt hasn't counted yet, because the
+ * kernel is locked or the interrupt is pending, is added from the flag.
+ */
+static inline systime_t st_lld_get_counter(void) {
+    uint32_t high, cnt, sr;
+
+    do {
+        high = st_lld_high;
+        cnt = STM32_ST_TIM->CNT;
+        sr = STM32_ST_TIM->SR;
+    } while(high != st_lld_high);
+    if((sr & STM32_TIM_SR_UIF) != 0 && cnt < 0x8000)
+        high += 0x10000;
+    return (systime_t)(high + cnt);
+}
+
+static inline void st_lld_start_alarm(systime_t time) {
+    STM32_ST_TIM->SR = ~STM32_TIM_SR_CC1IF;
+    STM32_ST_TIM->DIER |= STM32_TIM_DIER_CC1IE;
+    st_lld_arm(time);
+}
+
+static inline void st_lld_stop_alarm(void) {
+    STM32_ST_TIM->DIER &= ~STM32_TIM_DIER_CC1IE;
+}
+
+static inline void st_lld_set_alarm(systime_t time) {
+    st_lld_arm(time);
+}
+
+static inline systime_t st_lld_get_alarm(void) {
+    return st_lld_alarm;
+}
+
+static inline bool st_lld_is_alarm_active(void) {
+    return (STM32_ST_TIM->DIER & STM32_TIM_DIER_CC1IE) != 0;
+}
+
+#endif /* SRC_DRIVERS_ST_ST_LLD_H_ */
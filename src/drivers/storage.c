@@ -0,0 +1,64 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "storage.h"
+
+#if STORAGE_BACKEND == STORAGE_FLASH
+static const storage_backend_t *const backend = &storage_flash;
+#else
+static const storage_backend_t *const backend = &storage_eeprom;
+#endif
+
+static storage_stats_t stats;
+
+bool init_storage(void) {
+    chTMObjectInit(&stats.read_tm);
+    chTMObjectInit(&stats.write_tm);
+    return backend->init();
+}
+
+bool storage_read(const void *data, uint16_t addr, size_t n) {
+    bool res;
+    if(addr + n > backend->size)
+        return false;
+    chTMStartMeasurementX(&stats.read_tm);
+    res = backend->read(data, addr, n);
+    chTMStopMeasurementX(&stats.read_tm);
+    return res;
+}
+
+bool storage_write(uint16_t addr, const void *data, size_t n) {
+    bool res;
+    if(addr + n > backend->size)
+        return false;
+    chTMStartMeasurementX(&stats.write_tm);
+    res = backend->write(addr, data, n);
+    chTMStopMeasurementX(&stats.write_tm);
+    return res;
+}
+
+bool storage_flush(void) {
+    bool res;
+    chTMStartMeasurementX(&stats.write_tm);
+    res = backend->flush();
+    chTMStopMeasurementX(&stats.write_tm);
+    return res;
+}
+
+const void *storage_map(uint16_t addr, size_t n) {
+    if(backend->map == NULL || addr + n > backend->size)
+        return NULL;
+    return backend->map(addr, n);
+}
+
+uint16_t storage_size(void) {
+    return backend->size;
+}
+
+const char *storage_name(void) {
+    return backend->name;
+}
+
+const storage_stats_t *storage_get_stats(void) {
+    return &stats;
+}
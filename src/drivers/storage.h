@@ -0,0 +1,47 @@
+#ifndef SRC_DRIVERS_STORAGE_H_
+#define SRC_DRIVERS_STORAGE_H_
+
+#include "hal.h"
+
+/*
+ * Parameter storage backend. parameters.c only talks to the backend
+ * selected with STORAGE_BACKEND at build time.
+ */
+typedef struct {
+    const char *name;
+    uint16_t size;
+    bool (*init)(void);
+    bool (*read)(const void *data, uint16_t addr, size_t n);
+    // writes may be deferred until flush
+    bool (*write)(uint16_t addr, const void *data, size_t n);
+    bool (*flush)(void);
+    // zero-copy access, NULL if the backend is not memory mapped
+    const void *(*map)(uint16_t addr, size_t n);
+} storage_backend_t;
+
+#define STORAGE_EEPROM      0   // external I2C EEPROM with RAM mirror
+#define STORAGE_FLASH       1   // internal flash EEPROM emulation
+
+#ifndef STORAGE_BACKEND
+#define STORAGE_BACKEND     STORAGE_EEPROM
+#endif
+
+// Time spent in the backend, used to compare load time and write latency
+typedef struct {
+    time_measurement_t read_tm;
+    time_measurement_t write_tm;    // write and flush, what a parameter save costs
+} storage_stats_t;
+
+extern const storage_backend_t storage_eeprom;
+extern const storage_backend_t storage_flash;
+
+bool init_storage(void);
+bool storage_read(const void *data, uint16_t addr, size_t n);
+bool storage_write(uint16_t addr, const void *data, size_t n);
+bool storage_flush(void);
+const void *storage_map(uint16_t addr, size_t n);
+uint16_t storage_size(void);
+const char *storage_name(void);
+const storage_stats_t *storage_get_stats(void);
+
+#endif /* SRC_DRIVERS_STORAGE_H_ */
@@ -0,0 +1,286 @@
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "uart_dma.h"
+
+#if UART_DMA_USE_USART1
+uart_dma_t UDD1 = { .usart = USART1, .dmarx = STM32_DMA1_STREAM5, .dmatx = STM32_DMA1_STREAM4 };
+#endif
+#if UART_DMA_USE_USART2
+uart_dma_t UDD2 = { .usart = USART2, .dmarx = STM32_DMA1_STREAM6, .dmatx = STM32_DMA1_STREAM7 };
+#endif
+#if UART_DMA_USE_USART3
+uart_dma_t UDD3 = { .usart = USART3, .dmarx = STM32_DMA1_STREAM3, .dmatx = STM32_DMA1_STREAM2 };
+#endif
+
+static void rx_dma_cb(void *p, uint32_t flags) {
+    uart_dma_t *udp = (uart_dma_t *)p;
+    (void) flags;
+    if(udp->config->rx_cb != NULL)
+        udp->config->rx_cb(udp, UART_DMA_EVT_DATA);
+}
+
+#define TX_ABORTED 0xFFFF
+
+// Release the frame at the tail, kernel locked
+static void tx_advance(uart_dma_t *udp) {
+    pool_freeI(udp->config->tx_pool, udp->tx_frame[udp->tx_tail]);
+    udp->tx_len[udp->tx_tail] = 0;
+    if(++udp->tx_tail >= udp->config->tx_num_frames)
+        udp->tx_tail = 0;
+    udp->tx_count--;
+}
+
+// Start sending the frame at the tail if it is committed, kernel locked
+static void tx_kick(uart_dma_t *udp) {
+    while(!udp->tx_busy && udp->tx_count > 0) {
+        uint16_t len = udp->tx_len[udp->tx_tail];
+        if(len == 0)
+            return; // still being filled
+        if(len == TX_ABORTED) {
+            tx_advance(udp);
+            continue;
+        }
+        udp->tx_busy = true;
+        dmaStreamSetMemory0(udp->dmatx, udp->tx_frame[udp->tx_tail]);
+        dmaStreamSetTransactionSize(udp->dmatx, len);
+        dmaStreamEnable(udp->dmatx);
+    }
+}
+
+static void tx_latency(uart_dma_t *udp) {
+    uint32_t us = (chSysGetRealtimeCounterX() - udp->tx_time[udp->tx_tail]) / (STM32_HCLK / 1000000);
+    uint8_t b = 0;
+    while(b < UART_DMA_LAT_BUCKETS - 1 && us >= ((uint32_t)UART_DMA_LAT_BASE_US << b))
+        b++;
+    udp->tx_stats.latency[b]++;
+    if(us > udp->tx_stats.latency_max_us)
+        udp->tx_stats.latency_max_us = us;
+}
+
+static void tx_dma_cb(void *p, uint32_t flags) {
+    uart_dma_t *udp = (uart_dma_t *)p;
+    (void) flags;
+
+    chSysLockFromISR();
+    dmaStreamDisable(udp->dmatx);
+    udp->tx_stats.frames++;
+    udp->tx_stats.bytes += udp->tx_len[udp->tx_tail];
+    tx_latency(udp);
+    tx_advance(udp);
+    udp->tx_busy = false;
+    tx_kick(udp);
+    chSysUnlockFromISR();
+}
+
+static void serve_usart_irq(uart_dma_t *udp) {
+    USART_TypeDef *u = udp->usart;
+    uint16_t sr = u->SR;
+    uint8_t events = 0;
+
+    if(sr & (USART_SR_IDLE | USART_SR_ORE | USART_SR_NE | USART_SR_FE | USART_SR_PE)) {
+        // cleared by reading SR then DR, the data itself was taken by DMA
+        (void) u->DR;
+        if(sr & USART_SR_IDLE)
+            events |= UART_DMA_EVT_IDLE;
+        if(sr & (USART_SR_ORE | USART_SR_NE | USART_SR_FE | USART_SR_PE)) {
+            events |= UART_DMA_EVT_ERROR;
+            udp->rx_errors++;
+        }
+    }
+    if(events && udp->config->rx_cb != NULL)
+        udp->config->rx_cb(udp, events);
+}
+
+void uart_dma_start(uart_dma_t *udp, const uart_dma_config_t *config) {
+    USART_TypeDef *u = udp->usart;
+    uint32_t clock = STM32_PCLK1;
+    bool b;
+
+    udp->config = config;
+    udp->rx_tail = 0;
+    udp->tx_head = udp->tx_tail = udp->tx_count = 0;
+    udp->tx_busy = false;
+    memset(udp->tx_len, 0, sizeof(udp->tx_len));
+    uint16_t cr1 = config->cr1 | USART_CR1_UE;
+    uint16_t cr3 = 0;
+
+#if UART_DMA_USE_USART1
+    if(udp == &UDD1) {
+        rccEnableUSART1(FALSE);
+        nvicEnableVector(STM32_USART1_NUMBER, UART_DMA_IRQ_PRIORITY);
+        clock = STM32_PCLK2;
+    }
+#endif
+#if UART_DMA_USE_USART2
+    if(udp == &UDD2) {
+        rccEnableUSART2(FALSE);
+        nvicEnableVector(STM32_USART2_NUMBER, UART_DMA_IRQ_PRIORITY);
+    }
+#endif
+#if UART_DMA_USE_USART3
+    if(udp == &UDD3) {
+        rccEnableUSART3(FALSE);
+        nvicEnableVector(STM32_USART3_NUMBER, UART_DMA_IRQ_PRIORITY);
+    }
+#endif
+
+    if(config->rx_buf != NULL) {
+        b = dmaStreamAllocate(udp->dmarx, UART_DMA_IRQ_PRIORITY, rx_dma_cb, udp);
+        osalDbgAssert(!b, "stream already allocated");
+        dmaStreamSetPeripheral(udp->dmarx, &u->DR);
+        dmaStreamSetMemory0(udp->dmarx, config->rx_buf);
+        dmaStreamSetTransactionSize(udp->dmarx, config->rx_size);
+        dmaStreamSetMode(udp->dmarx, STM32_DMA_CR_PL(UART_DMA_DMA_PRIORITY) |
+                STM32_DMA_CR_DIR_P2M | STM32_DMA_CR_MINC | STM32_DMA_CR_CIRC |
+                STM32_DMA_CR_HTIE | STM32_DMA_CR_TCIE);
+        dmaStreamEnable(udp->dmarx);
+        cr1 |= USART_CR1_RE | USART_CR1_IDLEIE | USART_CR1_PEIE;
+        cr3 |= USART_CR3_DMAR | USART_CR3_EIE;
+    }
+
+    if(config->tx_pool != NULL) {
+        osalDbgAssert(config->tx_num_frames <= UART_DMA_TX_MAX_FRAMES, "too many frames");
+        b = dmaStreamAllocate(udp->dmatx, UART_DMA_IRQ_PRIORITY, tx_dma_cb, udp);
+        osalDbgAssert(!b, "stream already allocated");
+        dmaStreamSetPeripheral(udp->dmatx, &u->DR);
+        dmaStreamSetMode(udp->dmatx, STM32_DMA_CR_PL(UART_DMA_DMA_PRIORITY) |
+                STM32_DMA_CR_DIR_M2P | STM32_DMA_CR_MINC | STM32_DMA_CR_TCIE);
+        cr1 |= USART_CR1_TE;
+        cr3 |= USART_CR3_DMAT;
+    }
+
+    u->BRR = (clock + config->speed / 2) / config->speed;
+    u->CR2 = config->cr2;
+    u->CR3 = cr3;
+    u->CR1 = cr1;
+}
+
+void uart_dma_stop(uart_dma_t *udp) {
+    udp->usart->CR1 = 0;
+    udp->usart->CR3 = 0;
+    if(udp->config->rx_buf != NULL) {
+        dmaStreamDisable(udp->dmarx);
+        dmaStreamRelease(udp->dmarx);
+    }
+    if(udp->config->tx_pool != NULL) {
+        dmaStreamDisable(udp->dmatx);
+        dmaStreamRelease(udp->dmatx);
+    }
+}
+
+// Bytes received and not read yet
+uint16_t uart_dma_rx_available(uart_dma_t *udp) {
+    uint16_t head = udp->config->rx_size - dmaStreamGetTransactionSize(udp->dmarx);
+    if(head >= udp->rx_tail)
+        return head - udp->rx_tail;
+    return udp->config->rx_size - udp->rx_tail + head;
+}
+
+// Next received byte or -1
+int16_t uart_dma_getc(uart_dma_t *udp) {
+    uint8_t c;
+    if(uart_dma_rx_available(udp) == 0)
+        return -1;
+    c = udp->config->rx_buf[udp->rx_tail];
+    if(++udp->rx_tail >= udp->config->rx_size)
+        udp->rx_tail = 0;
+    return c;
+}
+
+/*
+ * Reserve the next free TX frame, the pool object size to be filled in
+ * place. Returns NULL if the ring is full or the pool empty, the frame is
+ * counted dropped.
+ */
+uint8_t *uart_dma_tx_reserve(uart_dma_t *udp) {
+    uint8_t *frame = NULL;
+
+    chSysLock();
+    if(udp->tx_count < udp->config->tx_num_frames)
+        frame = pool_allocI(udp->config->tx_pool);
+    if(frame != NULL) {
+        udp->tx_frame[udp->tx_head] = frame;
+        if(++udp->tx_head >= udp->config->tx_num_frames)
+            udp->tx_head = 0;
+        udp->tx_count++;
+    } else {
+        udp->tx_stats.dropped++;
+    }
+    chSysUnlock();
+    return frame;
+}
+
+// Queue a reserved frame for sending, len 0 releases it unsent
+void uart_dma_tx_commit(uart_dma_t *udp, uint8_t *frame, uint16_t len) {
+    uint8_t i;
+
+    chSysLock();
+    // reserved frames lie between the tail and the head
+    i = udp->tx_tail;
+    while(udp->tx_frame[i] != frame) {
+        if(++i >= udp->config->tx_num_frames)
+            i = 0;
+    }
+    udp->tx_len[i] = len > 0 ? len : TX_ABORTED;
+    udp->tx_time[i] = chSysGetRealtimeCounterX();
+    tx_kick(udp);
+    chSysUnlock();
+}
+
+// Copy data into a frame and queue it, false if dropped
+bool uart_dma_write(uart_dma_t *udp, const uint8_t *data, uint16_t len) {
+    uint8_t *frame;
+    if(len > udp->config->tx_pool->size)
+        return false;
+    frame = uart_dma_tx_reserve(udp);
+    if(frame == NULL)
+        return false;
+    memcpy(frame, data, len);
+    uart_dma_tx_commit(udp, frame, len);
+    return true;
+}
+
+/*
+ * Upper bound of the bucket holding the given percentile of TX latency,
+ * in us. The last bucket reports the max seen.
+ */
+uint32_t uart_dma_latency_percentile(const uart_dma_tx_stats_t *stats, uint8_t percent) {
+    uint32_t total = 0, sum = 0;
+    for(uint8_t b = 0; b < UART_DMA_LAT_BUCKETS; b++)
+        total += stats->latency[b];
+    if(total == 0)
+        return 0;
+    for(uint8_t b = 0; b < UART_DMA_LAT_BUCKETS - 1; b++) {
+        sum += stats->latency[b];
+        if(sum * 100 >= total * percent)
+            return (uint32_t)UART_DMA_LAT_BASE_US << b;
+    }
+    return stats->latency_max_us;
+}
+
+#if UART_DMA_USE_USART1
+OSAL_IRQ_HANDLER(STM32_USART1_HANDLER) {
+    OSAL_IRQ_PROLOGUE();
+    serve_usart_irq(&UDD1);
+    OSAL_IRQ_EPILOGUE();
+}
+#endif
+
+#if UART_DMA_USE_USART2
+OSAL_IRQ_HANDLER(STM32_USART2_HANDLER) {
+    OSAL_IRQ_PROLOGUE();
+    serve_usart_irq(&UDD2);
+    OSAL_IRQ_EPILOGUE();
+}
+#endif
+
+#if UART_DMA_USE_USART3
+OSAL_IRQ_HANDLER(STM32_USART3_HANDLER) {
+    OSAL_IRQ_PROLOGUE();
+    serve_usart_irq(&UDD3);
+    OSAL_IRQ_EPILOGUE();
+}
+#endif
@@ -0,0 +1,128 @@
+#ifndef SRC_DRIVERS_UART_DMA_H_
+#define SRC_DRIVERS_UART_DMA_H_
+
+#include "hal.h"
+
+#include "pools.h"
+
+/*
+ * USART driver with circular DMA reception. Received bytes go straight
+ * into a ring buffer, the CPU is only notified on idle line and on half
+ * and full ring, never per byte.
+ *
+ * Transmission uses frame buffers from an object pool, which several
+ * USARTs may share, queued in a ring per USART. Senders fill a reserved
+ * frame in place and commit it, DMA sends committed frames back to back
+ * and returns them to the pool. Senders never wait for the line, a full
+ * ring or an empty pool drops the frame.
+ *
+ * DMA1 channels on the F103: USART1 RX ch5 TX ch4, USART2 RX ch6 TX ch7
+ * (shared with I2C1), USART3 RX ch3 TX ch2.
+ */
+#ifndef UART_DMA_USE_USART1
+#define UART_DMA_USE_USART1     TRUE    // MAVLink
+#endif
+#ifndef UART_DMA_USE_USART2
+#define UART_DMA_USE_USART2     FALSE
+#endif
+#ifndef UART_DMA_USE_USART3
+#define UART_DMA_USE_USART3     TRUE    // second MAVLink link or SBUS
+#endif
+// SBUS input on USART3 instead of the second MAVLink link
+#ifndef SBUS_ENABLED
+#define SBUS_ENABLED            FALSE
+#endif
+
+#ifndef UART_DMA_IRQ_PRIORITY
+#define UART_DMA_IRQ_PRIORITY   12
+#endif
+#ifndef UART_DMA_DMA_PRIORITY
+#define UART_DMA_DMA_PRIORITY   1
+#endif
+
+#if UART_DMA_USE_USART1 && (STM32_SERIAL_USE_USART1 || STM32_UART_USE_USART1)
+#error "USART1 is already used by the serial or UART driver"
+#endif
+#if UART_DMA_USE_USART2 && (STM32_SERIAL_USE_USART2 || STM32_UART_USE_USART2)
+#error "USART2 is already used by the serial or UART driver"
+#endif
+#if UART_DMA_USE_USART2 && STM32_I2C_USE_I2C1
+#error "USART2 DMA (DMA1 ch6, ch7) is used by I2C1"
+#endif
+#if UART_DMA_USE_USART3 && (STM32_SERIAL_USE_USART3 || STM32_UART_USE_USART3)
+#error "USART3 is already used by the serial or UART driver"
+#endif
+
+// events passed to the rx callback
+#define UART_DMA_EVT_DATA       1   // half or full ring received
+#define UART_DMA_EVT_IDLE       2   // line went idle, end of a frame
+#define UART_DMA_EVT_ERROR      4   // framing, noise, parity or overrun
+
+#define UART_DMA_TX_MAX_FRAMES  8
+
+typedef struct uart_dma uart_dma_t;
+
+// Called from the IRQ, should drain the ring with uart_dma_getc()
+typedef void (*uart_dma_rx_cb_t)(uart_dma_t *udp, uint8_t events);
+
+typedef struct {
+    uint32_t speed;
+    uint16_t cr1;               // extra CR1 bits, M, PCE, PS
+    uint16_t cr2;               // extra CR2 bits, STOP
+    uint8_t *rx_buf;            // ring buffer, written by DMA, NULL for no RX
+    uint16_t rx_size;
+    uart_dma_rx_cb_t rx_cb;
+    obj_pool_t *tx_pool;        // TX frame buffers, NULL for no TX
+    uint8_t tx_num_frames;      // queued frames at most, up to UART_DMA_TX_MAX_FRAMES
+} uart_dma_config_t;
+
+// TX latency histogram, commit to last byte handed to the USART.
+// Bucket n counts frames below UART_DMA_LAT_BASE_US << n, the last one the rest.
+#define UART_DMA_LAT_BUCKETS    8
+#define UART_DMA_LAT_BASE_US    250
+
+typedef struct {
+    uint32_t frames;
+    uint32_t bytes;
+    uint32_t dropped;           // ring full or no frame left in the pool
+    uint32_t latency[UART_DMA_LAT_BUCKETS];
+    uint32_t latency_max_us;
+} uart_dma_tx_stats_t;
+
+struct uart_dma {
+    USART_TypeDef *usart;
+    const stm32_dma_stream_t *dmarx;
+    const stm32_dma_stream_t *dmatx;
+    const uart_dma_config_t *config;
+    uint16_t rx_tail;           // next byte to read from the ring
+    uint32_t rx_errors;
+    uint8_t tx_head;            // next frame to reserve
+    uint8_t tx_tail;            // frame being sent or next to send
+    uint8_t tx_count;           // reserved, committed or sending frames
+    bool tx_busy;
+    uint8_t *tx_frame[UART_DMA_TX_MAX_FRAMES];  // from the pool
+    uint16_t tx_len[UART_DMA_TX_MAX_FRAMES];    // 0 until committed
+    rtcnt_t tx_time[UART_DMA_TX_MAX_FRAMES];    // commit time
+    uart_dma_tx_stats_t tx_stats;
+};
+
+#if UART_DMA_USE_USART1
+extern uart_dma_t UDD1;
+#endif
+#if UART_DMA_USE_USART2
+extern uart_dma_t UDD2;
+#endif
+#if UART_DMA_USE_USART3
+extern uart_dma_t UDD3;
+#endif
+
+void uart_dma_start(uart_dma_t *udp, const uart_dma_config_t *config);
+void uart_dma_stop(uart_dma_t *udp);
+uint16_t uart_dma_rx_available(uart_dma_t *udp);
+int16_t uart_dma_getc(uart_dma_t *udp);
+uint8_t *uart_dma_tx_reserve(uart_dma_t *udp);
+void uart_dma_tx_commit(uart_dma_t *udp, uint8_t *frame, uint16_t len);
+bool uart_dma_write(uart_dma_t *udp, const uint8_t *data, uint16_t len);
+uint32_t uart_dma_latency_percentile(const uart_dma_tx_stats_t *stats, uint8_t percent);
+
+#endif /* SRC_DRIVERS_UART_DMA_H_ */
@@ -0,0 +1,170 @@
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "mavlink_bridge.h"
+#include "mavlink.h"
+
+#include "kernel_trace.h"
+
+#define HEADER_SIZE         10
+#define FRAME_SIZE          96      // DATA96 payload
+#define THREAD_RECORD_SIZE  (4 + KERNEL_TRACE_NAME_LEN)
+#define EVENT_RECORD_SIZE   14
+#define THREADS_PER_FRAME   ((FRAME_SIZE - HEADER_SIZE) / THREAD_RECORD_SIZE)
+#define EVENTS_PER_FRAME    ((FRAME_SIZE - HEADER_SIZE) / EVENT_RECORD_SIZE)
+
+#if CH_DBG_ENABLE_TRACE
+
+#if CH_DBG_TRACE_BUFFER_SIZE > 255
+#error "The trace dump indexes records with a byte"
+#endif
+
+typedef struct {
+    const thread_t *tp;
+    const char *name;
+} trace_thread_t;
+
+static ch_swc_event_t events[CH_DBG_TRACE_BUFFER_SIZE];
+static uint8_t num_events;
+static trace_thread_t threads[KERNEL_TRACE_MAX_THREADS];
+static uint8_t num_threads;
+static uint8_t dump_id = 0;
+static uint8_t send_pos;
+static volatile bool active = false;
+
+/*
+ * Take a copy of the trace ring, oldest event first, and start sending
+ * it. Returns false while the previous dump is still being sent.
+ */
+bool kernel_trace_request(void) {
+    ch_trace_buffer_t *tb = &ch.dbg.trace_buffer;
+    thread_t *tp;
+    size_t first;
+
+    if(active)
+        return false;
+
+    // threads that exit before the dump is decoded show up by address
+    num_threads = 0;
+    tp = chRegFirstThread();
+    while(tp != NULL) {
+        if(num_threads < KERNEL_TRACE_MAX_THREADS) {
+            threads[num_threads].tp = tp;
+            threads[num_threads].name = chRegGetThreadNameX(tp);
+            num_threads++;
+        }
+        tp = chRegNextThread(tp);
+    }
+
+    // short copy with the kernel locked, the ring keeps moving otherwise
+    chSysLock();
+    first = tb->tb_ptr - tb->tb_buffer;
+    memcpy(events, &tb->tb_buffer[first],
+            (CH_DBG_TRACE_BUFFER_SIZE - first) * sizeof(ch_swc_event_t));
+    memcpy(&events[CH_DBG_TRACE_BUFFER_SIZE - first], tb->tb_buffer,
+            first * sizeof(ch_swc_event_t));
+    chSysUnlock();
+
+    // until the ring wraps once the slots ahead of tb_ptr were never written
+    num_events = 0;
+    for(uint8_t i = 0; i < CH_DBG_TRACE_BUFFER_SIZE; i++) {
+        if(events[i].se_tp != NULL)
+            events[num_events++] = events[i];
+    }
+
+    dump_id++;
+    send_pos = 0;
+    active = true;
+    return true;
+}
+
+bool kernel_trace_active(void) {
+    return active;
+}
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+static uint8_t put_header(uint8_t *data, uint8_t kind, uint8_t first, uint8_t total, uint8_t per_frame) {
+    uint8_t n = total - first < per_frame ? total - first : per_frame;
+    data[0] = kind;
+    data[1] = dump_id;
+    data[2] = n;
+    data[3] = first;
+    put_u32(data + 4, CH_CFG_ST_FREQUENCY);
+    put_u16(data + 8, total);
+    return n;
+}
+
+/*
+ * SR_TRACE stream, one DATA96 of the current dump per call. Sends
+ * nothing without a pending dump.
+ */
+uint16_t kernel_trace_send(const mavlink_links_t *links) {
+    uint8_t data[FRAME_SIZE];
+    uint8_t thread_frames = (num_threads + THREADS_PER_FRAME - 1) / THREADS_PER_FRAME;
+    uint8_t *p = data + HEADER_SIZE;
+    uint8_t n;
+
+    if(!active)
+        return 0;
+
+    memset(data, 0, sizeof(data));
+    if(send_pos < thread_frames) {
+        uint8_t first = send_pos * THREADS_PER_FRAME;
+        n = put_header(data, KERNEL_TRACE_THREADS, first, num_threads, THREADS_PER_FRAME);
+        for(uint8_t i = first; i < first + n; i++) {
+            put_u32(p, (uint32_t)threads[i].tp);
+            if(threads[i].name != NULL)
+                strncpy((char *)p + 4, threads[i].name, KERNEL_TRACE_NAME_LEN);
+            p += THREAD_RECORD_SIZE;
+        }
+    } else {
+        uint8_t first = (send_pos - thread_frames) * EVENTS_PER_FRAME;
+        n = put_header(data, KERNEL_TRACE_EVENTS, first, num_events, EVENTS_PER_FRAME);
+        for(uint8_t i = first; i < first + n; i++) {
+            put_u32(p, events[i].se_time);
+            p[4] = events[i].se_state;
+            put_u32(p + 6, (uint32_t)events[i].se_tp);
+            put_u32(p + 10, (uint32_t)events[i].se_wtobjp);
+            p += EVENT_RECORD_SIZE;
+        }
+        if(first + n >= num_events)
+            active = false;
+    }
+    send_pos++;
+
+    for(uint8_t i = 0; i < links->n; i++) {
+        mavlink_lock(links->chan[i]);
+        mavlink_msg_data96_send(links->chan[i], KERNEL_TRACE_DATA_TYPE, p - data, data);
+        mavlink_unlock(links->chan[i]);
+    }
+    return MAVLINK_MSG_ID_DATA96_LEN + MAVLINK_NUM_NON_PAYLOAD_BYTES;
+}
+
+#else /* !CH_DBG_ENABLE_TRACE */
+
+// release builds have no trace buffer
+bool kernel_trace_request(void) {
+    return false;
+}
+
+bool kernel_trace_active(void) {
+    return false;
+}
+
+uint16_t kernel_trace_send(const mavlink_links_t *links) {
+    (void) links;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef SRC_KERNEL_TRACE_H_
+#define SRC_KERNEL_TRACE_H_
+
+#include "ch.h"
+#include "hal.h"
+
+#include "mavlink_bridge.h"
+
+/*
+ * Export of the kernel context switch trace (CH_DBG_ENABLE_TRACE). On
+ * MAV_CMD_USER_2 the trace ring is copied in one go, then sent on the SR_TRACE
+ * stream as DATA96 messages, type KERNEL_TRACE_DATA_TYPE, each starting
+ * with
+ *   u8 kind, u8 dump id, u8 records, u8 index of the first record,
+ *   u32 system tick frequency, u16 total records of this kind
+ * The thread table goes first, KERNEL_TRACE_THREADS records of
+ *   u32 thread, char name[12]
+ * then KERNEL_TRACE_EVENTS records in time order of
+ *   u32 system time, u8 state the previous thread left in, u8 reserved,
+ *   u32 thread switched in, u32 object the previous thread waits on
+ * tools/kernel_trace_view.py turns a tlog into a Chrome trace timeline.
+ */
+#define KERNEL_TRACE_DATA_TYPE  0x4B
+#define KERNEL_TRACE_THREADS    0
+#define KERNEL_TRACE_EVENTS     1
+
+#define KERNEL_TRACE_MAX_THREADS    12
+#define KERNEL_TRACE_NAME_LEN       12
+
+bool kernel_trace_request(void);
+bool kernel_trace_active(void);
+uint16_t kernel_trace_send(const mavlink_links_t *links);
+
+#endif /* SRC_KERNEL_TRACE_H_ */
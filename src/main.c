@@ -4,24 +4,21 @@
 
 #include <math.h>
 
-#define M_2PI_3 (2*M_PI/3)
-
-/*
- * Blinker thread #1.
- */
-static THD_WORKING_AREA(waThread1, 128);
-static THD_FUNCTION(Thread1, arg) {
-
-    (void) arg;
+#include "tasks.h"
+#include "timebase.h"
+#include "supervisor.h"
+#include "led.h"
+#include "i2c_bus.h"
+#include "parameters_d.h"
+#include "rc_input.h"
+#include "sbus.h"
+#include "mavlink_bridge.h"
+#include "telemetry.h"
+#include "mavlink_rx.h"
+#include "tune_log.h"
+#include "monitor.h"
 
-    chRegSetThreadName("blinker");
-    while (true) {
-        palSetPad(GPIOB, GPIOB_LED0);
-        chThdSleepMilliseconds(250);
-        palClearPad(GPIOB, GPIOB_LED0);
-        chThdSleepMilliseconds(250);
-    }
-}
+#define M_2PI_3 (2*M_PI/3)
 
 static PWMConfig pwmcfg = {
   72000000,                                 /* 72MHz PWM clock frequency.   */
@@ -41,30 +38,54 @@ static PWMConfig pwmcfg = {
 };
 
 
+#define CONTROL_PERIOD_US 5000
+
+/*
+ * Motor update, 200 Hz.
+ */
+static void control_update(void) {
+    static float angle = 0;
+    float duty = 0;
+
+    if(angle < 1*M_PI) {
+        duty = 5000 + 2500*sinf(angle);
+        pwmEnableChannel(&PWMD3, 3, duty);
+        pwmEnableChannel(&PWMD3, 2, 5000 + 2500*sinf(angle - M_2PI_3));
+        pwmEnableChannel(&PWMD3, 1, 5000 + 2500*sinf(angle + M_2PI_3));
+        angle += 0.01f;
+    }
+    // open loop, no measurement or PID terms yet
+    tune_log_capture(TUNE_LOG_DRIVE, CONTROL_PERIOD_US, angle, 0, 0, 0, 0, duty);
+}
+
+TASK_DEF_SUPERVISED(control_task, "control", control_update, CONTROL_PERIOD_US, 256, 20000);
+
 int main(void) {
     halInit();
     chSysInit();
+    init_timebase();
+    init_supervisor();
 
     pwmStart(&PWMD3, &pwmcfg);
     PWMD3.tim->CR1 |= STM32_TIM_CR1_CMS(1); //Set Center aligned mode
 
-    sdStart(&SD3, NULL);
-    /*
-     * Creates the example threads.
-     */
-    chThdCreateStatic(waThread1, sizeof(waThread1), NORMALPRIO + 1, Thread1,
-    NULL);
+    init_led();
+    init_i2c_bus();
+    load_parameters();
+    init_rc_input();
+#if SBUS_ENABLED
+    init_sbus();
+#endif
+    init_mavlink_links();
+    init_telemetry();
+    init_mavlink_rx();
+    init_monitor();
+
+    if(!tasks_add(&control_task))
+        chSysHalt("control task");
+    tasks_start();
 
-    float angle = 0;
-    uint32_t test = 0;
     while (TRUE) {
-        if(angle < 1*M_PI) {
-            test = 2500*sinf(angle);
-            pwmEnableChannel(&PWMD3, 3, 5000 + 2500*sinf(angle));
-            pwmEnableChannel(&PWMD3, 2, 5000 + 2500*sinf(angle - M_2PI_3));
-            pwmEnableChannel(&PWMD3, 1, 5000 + 2500*sinf(angle + M_2PI_3));
-            angle += 0.01f;
-        }
-        chThdSleepMilliseconds(5);
+        chThdSleep(TIME_INFINITE);
     }
 }
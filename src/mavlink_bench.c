@@ -0,0 +1,126 @@
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+#include "chprintf.h"
+
+#include "mavlink_bridge.h"
+#include "mavlink.h"
+
+#include "mavlink_bench.h"
+#include "parameters.h"
+
+#if MAVLINK_BENCH
+
+#define STATUSTEXT_LEN  50
+
+static const char *mix_names[BENCH_NUM_MIXES] = {
+    "all", "hb", "param", "data96", "telem"
+};
+
+static mavlink_channel_t bench_chan;
+static uint8_t bench_mix;
+static uint16_t bench_seconds;
+static thread_t *bench_thread = NULL;
+
+static void send_one(mavlink_channel_t chan, uint8_t mix, uint32_t n) {
+    static const uint8_t data[96];
+    static const char name[AP_MAX_NAME_SIZE] = "BENCH";
+
+    // telemetry mix cycles through the others, its own slot is rc channels
+    if(mix == BENCH_MIX_TELEMETRY)
+        mix = BENCH_MIX_HEARTBEAT + n % 4;
+    switch(mix) {
+    case BENCH_MIX_HEARTBEAT:
+        mavlink_msg_heartbeat_send(chan, MAV_TYPE_GIMBAL, MAV_AUTOPILOT_INVALID, 0, 0, MAV_STATE_ACTIVE);
+        break;
+    case BENCH_MIX_PARAM:
+        mavlink_msg_param_value_send(chan, name, (float)n, MAV_PARAM_TYPE_REAL32, 1, 0);
+        break;
+    case BENCH_MIX_DATA96:
+        mavlink_msg_data96_send(chan, 0, sizeof(data), data);
+        break;
+    default:
+        mavlink_msg_rc_channels_raw_send(chan, n, 0, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 255);
+        break;
+    }
+}
+
+static void run_mix(mavlink_channel_t chan, uint8_t mix, uint16_t seconds) {
+    const uart_dma_tx_stats_t *txs = mavlink_tx_stats(chan);
+    const time_measurement_t *tm = mavlink_tx_time(chan);
+    uart_dma_tx_stats_t start, delta;
+    rttime_t cpu_start;
+    ucnt_t n_start;
+    char text[STATUSTEXT_LEN + 1];
+    systime_t begin, end;
+    uint32_t sent = 0;
+
+    if(txs == NULL || tm == NULL)
+        return;
+
+    memcpy(&start, txs, sizeof(start));
+    cpu_start = tm->cumulative;
+    n_start = tm->n;
+
+    begin = chVTGetSystemTime();
+    end = begin + S2ST(seconds);
+    while(chVTIsSystemTimeWithin(begin, end)) {
+        uint32_t dropped = txs->dropped;
+        mavlink_lock(chan);
+        send_one(chan, mix, sent);
+        mavlink_unlock(chan);
+        if(txs->dropped != dropped)
+            chThdSleep(1);  // ring full, wait for the line
+        else
+            sent++;
+    }
+    chThdSleepMilliseconds(100); // let the ring drain
+
+    delta.frames = txs->frames - start.frames;
+    delta.bytes = txs->bytes - start.bytes;
+    for(uint8_t b = 0; b < UART_DMA_LAT_BUCKETS; b++)
+        delta.latency[b] = txs->latency[b] - start.latency[b];
+    delta.latency_max_us = txs->latency_max_us;
+
+    uint32_t cpu_us = 0;
+    if(tm->n != n_start)
+        cpu_us = (uint32_t)((tm->cumulative - cpu_start) / (tm->n - n_start) / (STM32_HCLK / 1000000));
+
+    chsnprintf(text, sizeof(text), "%s %lum/s %luB/s %luus p50 %lu p99 %lu",
+            mix_names[mix], delta.frames / seconds, delta.bytes / seconds, cpu_us,
+            uart_dma_latency_percentile(&delta, 50), uart_dma_latency_percentile(&delta, 99));
+    mavlink_lock(chan);
+    mavlink_msg_statustext_send(chan, MAV_SEVERITY_INFO, text);
+    mavlink_unlock(chan);
+}
+
+static THD_WORKING_AREA(waBench, 512);
+static THD_FUNCTION(Bench, arg) {
+    (void) arg;
+
+    chRegSetThreadName("mavlink_bench");
+    if(bench_mix == BENCH_MIX_ALL) {
+        for(uint8_t mix = BENCH_MIX_ALL + 1; mix < BENCH_NUM_MIXES; mix++)
+            run_mix(bench_chan, mix, bench_seconds);
+    } else {
+        run_mix(bench_chan, bench_mix, bench_seconds);
+    }
+}
+
+// Start a run on chan, false if one is already running
+bool mavlink_bench_start(mavlink_channel_t chan, uint8_t mix, uint16_t seconds) {
+    if(bench_thread != NULL && !chThdTerminatedX(bench_thread))
+        return false;
+    if(mix >= BENCH_NUM_MIXES || chan >= MAVLINK_NUM_LINKS || mavlink_tx_stats(chan) == NULL)
+        return false;
+
+    bench_chan = chan;
+    bench_mix = mix;
+    bench_seconds = seconds > 0 && seconds <= MAVLINK_BENCH_MAX_SECONDS ?
+            seconds : MAVLINK_BENCH_MAX_SECONDS;
+    bench_thread = chThdCreateStatic(waBench, sizeof(waBench), NORMALPRIO - 2, Bench, NULL);
+    return true;
+}
+
+#endif /* MAVLINK_BENCH */
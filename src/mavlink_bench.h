@@ -0,0 +1,36 @@
+#ifndef SRC_MAVLINK_BENCH_H_
+#define SRC_MAVLINK_BENCH_H_
+
+#include "ch.h"
+#include "hal.h"
+
+#include "mavlink_bridge.h"
+
+/*
+ * On-target MAVLink TX benchmark, started with COMMAND_LONG
+ * MAV_CMD_USER_1 (param1 mix, 0 for all, param2 seconds per mix, max
+ * MAVLINK_BENCH_MAX_SECONDS).
+ * Every mix is sent as fast as the link takes it and the result is
+ * reported as STATUSTEXT on the requesting link:
+ *   <mix> <msg/s>m/s <bytes/s>B/s <cpu us/msg>us p50 <us> p99 <us>
+ * Latency is commit to last byte handed to the UART.
+ */
+#ifndef MAVLINK_BENCH
+#define MAVLINK_BENCH           FALSE
+#endif
+#define MAVLINK_BENCH_MAX_SECONDS   60
+
+enum mavlink_bench_mixes {
+    BENCH_MIX_ALL = 0,
+    BENCH_MIX_HEARTBEAT,
+    BENCH_MIX_PARAM,
+    BENCH_MIX_DATA96,
+    BENCH_MIX_TELEMETRY,        // heartbeat, param, rc channels, data96
+    BENCH_NUM_MIXES
+};
+
+#if MAVLINK_BENCH
+bool mavlink_bench_start(mavlink_channel_t chan, uint8_t mix, uint16_t seconds);
+#endif
+
+#endif /* SRC_MAVLINK_BENCH_H_ */
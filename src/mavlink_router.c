@@ -0,0 +1,170 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "mavlink_router.h"
+#include "telemetry.h"
+
+/*
+ * Routing between the MAVLink links, along the lines of the ArduPilot
+ * router. The source of every received message is learned as a route to
+ * the link it came in on. Untargeted and broadcast messages go to all
+ * other links and are handled locally, targeted messages only go to links
+ * with a route to the target and are handled locally only if they are
+ * for us.
+ */
+
+static mavlink_route_t routes[MAVLINK_MAX_ROUTES];
+static uint8_t num_routes = 0;
+static mavlink_router_stats_t stats;
+
+static void learn_route(mavlink_channel_t in, const mavlink_message_t *msg) {
+    uint8_t i;
+    for(i = 0; i < num_routes; i++) {
+        if(routes[i].sysid == msg->sysid && routes[i].compid == msg->compid) {
+            routes[i].chan = in;    // system moved to another link
+            return;
+        }
+    }
+    if(num_routes >= MAVLINK_MAX_ROUTES) {
+        stats.routes_full++;
+        return;
+    }
+    routes[num_routes].sysid = msg->sysid;
+    routes[num_routes].compid = msg->compid;
+    routes[num_routes].chan = in;
+    num_routes++;
+}
+
+/*
+ * Target of the message, -1 if it has none. Only messages a gimbal,
+ * autopilot or GCS on our links exchange with a target are listed.
+ */
+static void get_target(const mavlink_message_t *msg, int16_t *sysid, int16_t *compid) {
+    *sysid = -1;
+    *compid = -1;
+
+    switch(msg->msgid) {
+    case MAVLINK_MSG_ID_SET_MODE:
+        *sysid = mavlink_msg_set_mode_get_target_system(msg);
+        break;
+    case MAVLINK_MSG_ID_PARAM_REQUEST_READ:
+        *sysid = mavlink_msg_param_request_read_get_target_system(msg);
+        *compid = mavlink_msg_param_request_read_get_target_component(msg);
+        break;
+    case MAVLINK_MSG_ID_PARAM_REQUEST_LIST:
+        *sysid = mavlink_msg_param_request_list_get_target_system(msg);
+        *compid = mavlink_msg_param_request_list_get_target_component(msg);
+        break;
+    case MAVLINK_MSG_ID_PARAM_SET:
+        *sysid = mavlink_msg_param_set_get_target_system(msg);
+        *compid = mavlink_msg_param_set_get_target_component(msg);
+        break;
+    case MAVLINK_MSG_ID_MISSION_REQUEST_LIST:
+        *sysid = mavlink_msg_mission_request_list_get_target_system(msg);
+        *compid = mavlink_msg_mission_request_list_get_target_component(msg);
+        break;
+    case MAVLINK_MSG_ID_MISSION_REQUEST:
+        *sysid = mavlink_msg_mission_request_get_target_system(msg);
+        *compid = mavlink_msg_mission_request_get_target_component(msg);
+        break;
+    case MAVLINK_MSG_ID_MISSION_COUNT:
+        *sysid = mavlink_msg_mission_count_get_target_system(msg);
+        *compid = mavlink_msg_mission_count_get_target_component(msg);
+        break;
+    case MAVLINK_MSG_ID_MISSION_ITEM:
+        *sysid = mavlink_msg_mission_item_get_target_system(msg);
+        *compid = mavlink_msg_mission_item_get_target_component(msg);
+        break;
+    case MAVLINK_MSG_ID_MISSION_ACK:
+        *sysid = mavlink_msg_mission_ack_get_target_system(msg);
+        *compid = mavlink_msg_mission_ack_get_target_component(msg);
+        break;
+    case MAVLINK_MSG_ID_REQUEST_DATA_STREAM:
+        *sysid = mavlink_msg_request_data_stream_get_target_system(msg);
+        *compid = mavlink_msg_request_data_stream_get_target_component(msg);
+        break;
+    case MAVLINK_MSG_ID_COMMAND_INT:
+        *sysid = mavlink_msg_command_int_get_target_system(msg);
+        *compid = mavlink_msg_command_int_get_target_component(msg);
+        break;
+    case MAVLINK_MSG_ID_COMMAND_LONG:
+        *sysid = mavlink_msg_command_long_get_target_system(msg);
+        *compid = mavlink_msg_command_long_get_target_component(msg);
+        break;
+    case MAVLINK_MSG_ID_MOUNT_CONFIGURE:
+        *sysid = mavlink_msg_mount_configure_get_target_system(msg);
+        *compid = mavlink_msg_mount_configure_get_target_component(msg);
+        break;
+    case MAVLINK_MSG_ID_MOUNT_CONTROL:
+        *sysid = mavlink_msg_mount_control_get_target_system(msg);
+        *compid = mavlink_msg_mount_control_get_target_component(msg);
+        break;
+    default:
+        break;
+    }
+}
+
+static void forward(mavlink_channel_t chan, const mavlink_message_t *msg) {
+    mavlink_lock(chan);
+    _mavlink_resend_uart(chan, msg);
+    mavlink_unlock(chan);
+    telemetry_account_bytes(msg->len + MAVLINK_NUM_NON_PAYLOAD_BYTES);
+    stats.forwarded++;
+}
+
+/*
+ * Learn the source of a message received on link in and forward it.
+ * Returns true if the message should be handled locally.
+ */
+bool mavlink_router_check(mavlink_channel_t in, const mavlink_message_t *msg) {
+    int16_t target_sys, target_comp;
+    bool sent[MAVLINK_COMM_NUM_BUFFERS] = { false };
+
+    if(msg->sysid == mavlink_system.sysid && msg->compid == mavlink_system.compid)
+        return false;   // our own message looped back
+
+    learn_route(in, msg);
+    get_target(msg, &target_sys, &target_comp);
+
+    if(target_sys <= 0) {
+        // untargeted or broadcast
+        for(uint8_t i = 0; i < MAVLINK_NUM_LINKS; i++) {
+            if(i != in && mavlink_link_active((mavlink_channel_t)i))
+                forward((mavlink_channel_t)i, msg);
+        }
+        stats.local++;
+        return true;
+    }
+
+    bool local = target_sys == mavlink_system.sysid &&
+            (target_comp <= 0 || target_comp == mavlink_system.compid);
+    if(local)
+        stats.local++;
+    if(local && target_comp == mavlink_system.compid)
+        return true;    // only for us
+
+    // component broadcast on our system or a system elsewhere
+    bool routed = false;
+    for(uint8_t i = 0; i < num_routes; i++) {
+        mavlink_channel_t chan = routes[i].chan;
+        if(routes[i].sysid != target_sys || chan == in || sent[chan])
+            continue;
+        if(target_comp > 0 && routes[i].compid != target_comp)
+            continue;
+        forward(chan, msg);
+        sent[chan] = true;
+        routed = true;
+    }
+    if(!routed && !local)
+        stats.no_route++;
+    return local;
+}
+
+uint8_t mavlink_router_get_routes(const mavlink_route_t **r) {
+    *r = routes;
+    return num_routes;
+}
+
+const mavlink_router_stats_t *mavlink_router_get_stats(void) {
+    return &stats;
+}
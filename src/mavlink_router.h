@@ -0,0 +1,29 @@
+#ifndef SRC_MAVLINK_ROUTER_H_
+#define SRC_MAVLINK_ROUTER_H_
+
+#include "ch.h"
+#include "hal.h"
+
+#include "mavlink_bridge.h"
+#include "mavlink.h"
+
+#define MAVLINK_MAX_ROUTES      8
+
+typedef struct {
+    uint8_t sysid;
+    uint8_t compid;
+    mavlink_channel_t chan;
+} mavlink_route_t;
+
+typedef struct {
+    uint32_t forwarded;         // copies sent to other links
+    uint32_t local;             // messages for us
+    uint32_t no_route;          // targeted at a system we haven't seen
+    uint32_t routes_full;       // new system seen with the table full
+} mavlink_router_stats_t;
+
+bool mavlink_router_check(mavlink_channel_t in, const mavlink_message_t *msg);
+uint8_t mavlink_router_get_routes(const mavlink_route_t **routes);
+const mavlink_router_stats_t *mavlink_router_get_stats(void);
+
+#endif /* SRC_MAVLINK_ROUTER_H_ */
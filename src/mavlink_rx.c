@@ -0,0 +1,222 @@
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "chprintf.h"
+
+#include "mavlink_rx.h"
+#include "mavlink_router.h"
+#include "parameters.h"
+#include "telemetry.h"
+#include "mavlink_bench.h"
+#include "kernel_trace.h"
+#include "rc_check.h"
+#include "rc_trace.h"
+
+/*
+ * MAVLink receive path. The RX buffers of all links are drained by a
+ * single parser thread, woken by the link RX events (idle line, half and
+ * full ring) so there is no per-byte interrupt. Complete messages go
+ * through the router and the ones for us are dispatched through a table
+ * indexed by msgid.
+ */
+
+static void handle_heartbeat(mavlink_channel_t chan, const mavlink_message_t *msg);
+static void handle_param_request_list(mavlink_channel_t chan, const mavlink_message_t *msg);
+static void handle_param_request_read(mavlink_channel_t chan, const mavlink_message_t *msg);
+static void handle_param_set(mavlink_channel_t chan, const mavlink_message_t *msg);
+static void handle_command_long(mavlink_channel_t chan, const mavlink_message_t *msg);
+
+static const mavlink_handler_t handlers[256] = {
+    [MAVLINK_MSG_ID_HEARTBEAT]          = handle_heartbeat,
+    [MAVLINK_MSG_ID_PARAM_REQUEST_READ] = handle_param_request_read,
+    [MAVLINK_MSG_ID_PARAM_REQUEST_LIST] = handle_param_request_list,
+    [MAVLINK_MSG_ID_PARAM_SET]          = handle_param_set,
+    [MAVLINK_MSG_ID_COMMAND_LONG]       = handle_command_long,
+};
+
+static mavlink_rx_stats_t stats[MAVLINK_COMM_NUM_BUFFERS];
+
+static void dispatch(mavlink_channel_t chan, const mavlink_message_t *msg) {
+    mavlink_handler_t handler = handlers[msg->msgid];
+    if(handler != NULL) {
+        handler(chan, msg);
+        stats[chan].messages++;
+    } else {
+        stats[chan].unhandled++;
+    }
+}
+
+static void parse_link(mavlink_channel_t chan) {
+    mavlink_message_t msg;
+    mavlink_status_t status;
+    int16_t c;
+
+    while((c = mavlink_rx_getc(chan)) >= 0) {
+        stats[chan].bytes++;
+        if(mavlink_parse_char(chan, (uint8_t)c, &msg, &status) &&
+                mavlink_router_check(chan, &msg))
+            dispatch(chan, &msg);
+    }
+    stats[chan].parse_errors = mavlink_get_channel_status(chan)->packet_rx_drop_count;
+}
+
+static THD_WORKING_AREA(waMavlinkRx, 768);
+static THD_FUNCTION(MavlinkRx, arg) {
+    (void) arg;
+
+    chRegSetThreadName("mavlink_rx");
+    for(uint8_t i = 0; i < MAVLINK_NUM_LINKS; i++)
+        mavlink_rx_attach((mavlink_channel_t)i);
+    while(true) {
+        eventmask_t events = chEvtWaitAny(ALL_EVENTS);
+        for(uint8_t i = 0; i < MAVLINK_NUM_LINKS; i++) {
+            if(events & EVENT_MASK(i))
+                parse_link((mavlink_channel_t)i);
+        }
+    }
+}
+
+void init_mavlink_rx(void) {
+    chThdCreateStatic(waMavlinkRx, sizeof(waMavlinkRx), NORMALPRIO + 1, MavlinkRx, NULL);
+}
+
+const mavlink_rx_stats_t *mavlink_rx_get_stats(mavlink_channel_t chan) {
+    return &stats[chan];
+}
+
+static bool for_us(uint8_t sysid, uint8_t compid) {
+    return sysid == mavlink_system.sysid &&
+            (compid == mavlink_system.compid || compid == MAV_COMP_ID_ALL);
+}
+
+// Position of a parameter in the list sent to the GCS
+static uint16_t param_index(const Info *info) {
+    ParamToken token;
+    return (uint16_t)(info - first_param(&token, NULL));
+}
+
+static void handle_heartbeat(mavlink_channel_t chan, const mavlink_message_t *msg) {
+    if(mavlink_msg_heartbeat_get_type(msg) == MAV_TYPE_GCS)
+        stats[chan].last_heartbeat = chVTGetSystemTime();
+}
+
+static void handle_param_request_list(mavlink_channel_t chan, const mavlink_message_t *msg) {
+    mavlink_param_request_list_t packet;
+    (void) chan;
+
+    mavlink_msg_param_request_list_decode(msg, &packet);
+    if(!for_us(packet.target_system, packet.target_component))
+        return;
+    telemetry_request_param_list();
+}
+
+static void handle_param_request_read(mavlink_channel_t chan, const mavlink_message_t *msg) {
+    mavlink_param_request_read_t packet;
+    char name[AP_MAX_NAME_SIZE + 1];
+    ap_var_type type;
+    const Info *info;
+
+    mavlink_msg_param_request_read_decode(msg, &packet);
+    if(!for_us(packet.target_system, packet.target_component))
+        return;
+
+    if(packet.param_index >= 0) {
+        ParamToken token;
+        info = first_param(&token, NULL);
+        for(int16_t i = 0; i < packet.param_index && info != NULL; i++)
+            info = next_scalar(&token, NULL);
+    } else {
+        strncpy(name, packet.param_id, AP_MAX_NAME_SIZE);
+        name[AP_MAX_NAME_SIZE] = 0;
+        info = find_using_name(name, &type);
+    }
+    if(info == NULL)
+        return;
+    telemetry_queue_param(chan, info, param_index(info));
+}
+
+// Set and save, save_parameter() sends the new value back to the GCS
+static void handle_param_set(mavlink_channel_t chan, const mavlink_message_t *msg) {
+    mavlink_param_set_t packet;
+    char name[AP_MAX_NAME_SIZE + 1];
+    ap_var_type type;
+    const Info *info;
+    (void) chan;
+
+    mavlink_msg_param_set_decode(msg, &packet);
+    if(!for_us(packet.target_system, packet.target_component))
+        return;
+
+    strncpy(name, packet.param_id, AP_MAX_NAME_SIZE);
+    name[AP_MAX_NAME_SIZE] = 0;
+    info = find_using_name(name, &type);
+    if(info == NULL || isnan(packet.param_value) || isinf(packet.param_value))
+        return;
+    set_and_save_using_pointer(info->ptr, packet.param_value, false);
+}
+
+#if RC_CHECK
+// Runs the RC decoder checks, failures are reported by name
+static uint8_t run_rc_check(mavlink_channel_t chan) {
+    char text[50 + 1];      // STATUSTEXT text field
+    uint32_t failed = rc_check_run();
+
+    for(uint8_t i = 0; i < rc_check_count(); i++) {
+        if(failed & (1UL << i)) {
+            chsnprintf(text, sizeof(text), "rc check %s failed", rc_check_name(i));
+            mavlink_lock(chan);
+            mavlink_msg_statustext_send(chan, MAV_SEVERITY_ERROR, text);
+            mavlink_unlock(chan);
+        }
+    }
+    return failed ? MAV_RESULT_FAILED : MAV_RESULT_ACCEPTED;
+}
+#endif
+
+static void handle_command_long(mavlink_channel_t chan, const mavlink_message_t *msg) {
+    mavlink_command_long_t packet;
+    uint8_t result = MAV_RESULT_UNSUPPORTED;
+
+    mavlink_msg_command_long_decode(msg, &packet);
+    if(!for_us(packet.target_system, packet.target_component))
+        return;
+
+    switch(packet.command) {
+#if MAVLINK_BENCH
+    case MAV_CMD_USER_1:
+        if(mavlink_bench_start(chan, (uint8_t)packet.param1, (uint16_t)packet.param2))
+            result = MAV_RESULT_ACCEPTED;
+        else
+            result = MAV_RESULT_TEMPORARILY_REJECTED;
+        break;
+#endif
+#if RC_CHECK
+    case MAV_CMD_USER_3:
+        result = run_rc_check(chan);
+        break;
+    case MAV_CMD_USER_4:
+        // record param1 RC edges and dump them on the SR_TRACE stream
+        if(rc_trace_request((uint16_t)packet.param1))
+            result = MAV_RESULT_ACCEPTED;
+        else
+            result = MAV_RESULT_TEMPORARILY_REJECTED;
+        break;
+#endif
+#if CH_DBG_ENABLE_TRACE
+    case MAV_CMD_USER_2:
+        // dump the kernel context switch trace on the SR_TRACE stream
+        if(kernel_trace_request())
+            result = MAV_RESULT_ACCEPTED;
+        else
+            result = MAV_RESULT_TEMPORARILY_REJECTED;
+        break;
+#endif
+    default:
+        break;
+    }
+    mavlink_lock(chan);
+    mavlink_msg_command_ack_send(chan, packet.command, result);
+    mavlink_unlock(chan);
+}
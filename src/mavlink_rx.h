@@ -0,0 +1,23 @@
+#ifndef SRC_MAVLINK_RX_H_
+#define SRC_MAVLINK_RX_H_
+
+#include "ch.h"
+#include "hal.h"
+
+#include "mavlink_bridge.h"
+#include "mavlink.h"
+
+typedef void (*mavlink_handler_t)(mavlink_channel_t chan, const mavlink_message_t *msg);
+
+typedef struct {
+    uint32_t messages;          // dispatched to a handler
+    uint32_t unhandled;         // valid but no handler
+    uint32_t bytes;
+    uint32_t parse_errors;      // bad CRC or framing
+    systime_t last_heartbeat;   // from the GCS
+} mavlink_rx_stats_t;
+
+void init_mavlink_rx(void);
+const mavlink_rx_stats_t *mavlink_rx_get_stats(mavlink_channel_t chan);
+
+#endif /* SRC_MAVLINK_RX_H_ */
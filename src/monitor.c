@@ -0,0 +1,195 @@
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "mavlink_bridge.h"
+#include "mavlink.h"
+
+#include "monitor.h"
+#include "tasks.h"
+#include "pools.h"
+#include "supervisor.h"
+
+#if !CH_DBG_STATISTICS
+#error "The thread monitor needs CH_DBG_STATISTICS"
+#endif
+
+static monitor_thread_t threads[MONITOR_MAX_THREADS];
+static monitor_stats_t stats;
+static mutex_t mtx;     // snapshot is written by the monitor task, read by telemetry
+
+static rtcnt_t last_sample;
+static ucnt_t last_irq, last_ctxsw;
+static uint8_t send_pos = 0;
+
+/*
+ * Bytes at the bottom of the stack still holding the fill pattern, the
+ * stack limit is right above the thread structure in its working area.
+ */
+static uint16_t stack_free(const thread_t *tp) {
+#if CH_DBG_FILL_THREADS
+    const uint8_t *p = (const uint8_t *)tp->p_stklimit;
+    uint16_t n = 0;
+
+    while(n < MONITOR_STACK_SCAN && p[n] == CH_DBG_STACK_FILL_VALUE)
+        n++;
+    return n;
+#else
+    (void) tp;
+    return MONITOR_STACK_UNKNOWN;
+#endif
+}
+
+static monitor_thread_t *find_slot(const thread_t *tp) {
+    monitor_thread_t *free_slot = NULL;
+    for(uint8_t i = 0; i < MONITOR_MAX_THREADS; i++) {
+        if(threads[i].tp == tp)
+            return &threads[i];
+        if(threads[i].tp == NULL && free_slot == NULL)
+            free_slot = &threads[i];
+    }
+    if(free_slot != NULL) {
+        free_slot->tp = tp;
+        free_slot->last_cumulative = tp->p_stats.cumulative;
+    }
+    return free_slot;
+}
+
+static void monitor_update(void) {
+    rtcnt_t now = chSysGetRealtimeCounterX();
+    rtcnt_t elapsed = now - last_sample;
+    ucnt_t irq = ch.kernel_stats.n_irq;
+    ucnt_t ctxsw = ch.kernel_stats.n_ctxswc;
+    uint8_t n = 0, low = 0;
+    bool seen[MONITOR_MAX_THREADS] = { false };
+    thread_t *tp;
+
+    last_sample = now;
+    if(elapsed == 0)
+        return;
+
+    chMtxLock(&mtx);
+    tp = chRegFirstThread();
+    while(tp != NULL) {
+        monitor_thread_t *t = find_slot(tp);
+        if(t != NULL) {
+            rttime_t used = tp->p_stats.cumulative - t->last_cumulative;
+            t->last_cumulative = tp->p_stats.cumulative;
+            t->name = chRegGetThreadNameX(tp);
+            t->cpu_permille = (uint16_t)((used * 1000) / elapsed);
+            t->stack_free = stack_free(tp);
+            t->prio = tp->p_prio;
+            t->flags = t->stack_free < MONITOR_STACK_WARN ? MONITOR_FLAG_STACK_LOW : 0;
+            if(t->flags & MONITOR_FLAG_STACK_LOW)
+                low++;
+            seen[t - threads] = true;
+            n++;
+        }
+        tp = chRegNextThread(tp);
+    }
+
+    stats.load_permille = 1000;
+    for(uint8_t i = 0; i < MONITOR_MAX_THREADS; i++) {
+        if(!seen[i])
+            threads[i].tp = NULL;   // exited
+        else if(threads[i].tp == chSysGetIdleThreadX())
+            stats.load_permille = 1000 - threads[i].cpu_permille;
+    }
+    stats.irq_rate = (uint64_t)(irq - last_irq) * STM32_HCLK / elapsed;
+    stats.ctxsw_rate = (uint64_t)(ctxsw - last_ctxsw) * STM32_HCLK / elapsed;
+    stats.stack_low = low;
+    stats.num_threads = n;
+    chMtxUnlock(&mtx);
+
+    last_irq = irq;
+    last_ctxsw = ctxsw;
+}
+
+TASK_DEF(monitor_task, "monitor", monitor_update, MONITOR_PERIOD_US, 256);
+
+// Registers the monitor task, call before tasks_start()
+void init_monitor(void) {
+    chMtxObjectInit(&mtx);
+    last_sample = chSysGetRealtimeCounterX();
+    if(!tasks_add(&monitor_task))
+        chSysHalt("monitor task");
+}
+
+static uint16_t send_pool(const mavlink_links_t *links, const obj_pool_t *pool) {
+    uint8_t data[32];
+
+    memset(data, 0, sizeof(data));
+    strncpy((char *)data, pool->name, MONITOR_NAME_LEN);
+    data[12] = pool->count & 0xFF;
+    data[13] = pool->count >> 8;
+    data[14] = pool->in_use & 0xFF;
+    data[15] = pool->in_use >> 8;
+    data[16] = pool->max_in_use & 0xFF;
+    data[17] = pool->max_in_use >> 8;
+    memcpy(&data[18], &pool->exhausted, sizeof(uint32_t));
+    for(uint8_t i = 0; i < links->n; i++) {
+        mavlink_lock(links->chan[i]);
+        mavlink_msg_data32_send(links->chan[i], MONITOR_POOL_DATA_TYPE, 22, data);
+        mavlink_unlock(links->chan[i]);
+    }
+    return MAVLINK_MSG_ID_DATA32_LEN + MAVLINK_NUM_NON_PAYLOAD_BYTES;
+}
+
+/*
+ * SR_SYSTEM stream, SYS_STATUS then one thread or pool per slot.
+ */
+uint16_t monitor_send(const mavlink_links_t *links) {
+    uint8_t data[32];
+
+    if(send_pos == 0) {
+        // errors_count1 task overruns, errors_count2 1 after a watchdog reset
+        for(uint8_t i = 0; i < links->n; i++) {
+            mavlink_lock(links->chan[i]);
+            mavlink_msg_sys_status_send(links->chan[i], 0, 0, 0, stats.load_permille,
+                    0, -1, -1, 0, 0, (uint16_t)supervisor_overruns(),
+                    supervisor_get_reset()->watchdog ? 1 : 0, 0, 0);
+            mavlink_unlock(links->chan[i]);
+        }
+        send_pos = 1;
+        return MAVLINK_MSG_ID_SYS_STATUS_LEN + MAVLINK_NUM_NON_PAYLOAD_BYTES;
+    }
+
+    // next monitored thread
+    while(send_pos <= MONITOR_MAX_THREADS && threads[send_pos - 1].tp == NULL)
+        send_pos++;
+    if(send_pos > MONITOR_MAX_THREADS) {
+        const obj_pool_t *pool = pools_get(send_pos - MONITOR_MAX_THREADS - 1);
+        if(pool == NULL) {
+            send_pos = 0;
+            return 0;
+        }
+        send_pos++;
+        return send_pool(links, pool);
+    }
+
+    chMtxLock(&mtx);
+    const monitor_thread_t *t = &threads[send_pos - 1];
+    memset(data, 0, sizeof(data));
+    if(t->name != NULL)
+        strncpy((char *)data, t->name, MONITOR_NAME_LEN);
+    data[12] = t->cpu_permille & 0xFF;
+    data[13] = t->cpu_permille >> 8;
+    data[14] = t->stack_free & 0xFF;
+    data[15] = t->stack_free >> 8;
+    data[16] = t->prio;
+    data[17] = t->flags;
+    chMtxUnlock(&mtx);
+
+    send_pos++;
+    for(uint8_t i = 0; i < links->n; i++) {
+        mavlink_lock(links->chan[i]);
+        mavlink_msg_data32_send(links->chan[i], MONITOR_DATA_TYPE, 18, data);
+        mavlink_unlock(links->chan[i]);
+    }
+    return MAVLINK_MSG_ID_DATA32_LEN + MAVLINK_NUM_NON_PAYLOAD_BYTES;
+}
+
+const monitor_stats_t *monitor_get_stats(void) {
+    return &stats;
+}
@@ -0,0 +1,58 @@
+#ifndef SRC_MONITOR_H_
+#define SRC_MONITOR_H_
+
+#include "ch.h"
+#include "hal.h"
+
+#include "mavlink_bridge.h"
+
+/*
+ * Thread monitor. Once a second the registry is walked for the CPU time
+ * of every thread (CH_DBG_STATISTICS) and the untouched part of its stack
+ * (CH_DBG_FILL_THREADS). Results go out on the SR_SYSTEM stream as
+ * SYS_STATUS (load) followed by one DATA32 per thread, type
+ * MONITOR_DATA_TYPE:
+ *   char name[12], u16 cpu permille, u16 stack free bytes, u8 prio, u8 flags
+ * and one DATA32 per object pool, type MONITOR_POOL_DATA_TYPE:
+ *   char name[12], u16 objects, u16 in use, u16 max in use, u32 exhausted
+ * Interrupt time is charged to the interrupted thread, the kernel only
+ * counts interrupts and context switches.
+ */
+#define MONITOR_DATA_TYPE       0x53
+#define MONITOR_POOL_DATA_TYPE  0x50
+#define MONITOR_PERIOD_US       1000000
+#define MONITOR_MAX_THREADS     12
+#define MONITOR_NAME_LEN        12
+// Threads with less free stack are flagged
+#ifndef MONITOR_STACK_WARN
+#define MONITOR_STACK_WARN      64
+#endif
+// Free stack is scanned up to this many bytes
+#define MONITOR_STACK_SCAN      1024
+
+#define MONITOR_FLAG_STACK_LOW  0x01
+#define MONITOR_STACK_UNKNOWN   0xFFFF  // built without CH_DBG_FILL_THREADS
+
+typedef struct {
+    const thread_t *tp;
+    const char *name;
+    rttime_t last_cumulative;
+    uint16_t cpu_permille;
+    uint16_t stack_free;
+    tprio_t prio;
+    uint8_t flags;
+} monitor_thread_t;
+
+typedef struct {
+    uint16_t load_permille;     // non idle time
+    uint32_t irq_rate;          // per second
+    uint32_t ctxsw_rate;        // per second
+    uint8_t stack_low;          // threads flagged
+    uint8_t num_threads;
+} monitor_stats_t;
+
+void init_monitor(void);
+uint16_t monitor_send(const mavlink_links_t *links);
+const monitor_stats_t *monitor_get_stats(void);
+
+#endif /* SRC_MONITOR_H_ */
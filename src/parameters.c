@@ -6,7 +6,7 @@
 
 #include "telemetry.h"
 #include "parameters.h"
-#include "eeprom.h"
+#include "storage.h"
 
 void write_sentinal(uint16_t ofs);
 void eeprom_write_check(const void *ptr, uint16_t ofs, uint8_t size);
@@ -22,6 +22,9 @@ void send_parameter(const Info *info, const char *name, ap_var_type var_type);
 
 const Info *_var_info;
 uint16_t _num_vars;
+// false if the storage backend failed to start, parameters keep their
+// defaults and nothing is read or written
+static bool storage_ok = false;
 
 // erase all EEPROM variables by re-writing the header and adding
 // a sentinal
@@ -29,6 +32,9 @@ void erase_all(void)
 {
     struct EEPROM_header hdr;
 
+    if(!storage_ok)
+        return;
+
     // write the header
     hdr.magic[0] = k_EEPROM_magic0;
     hdr.magic[1] = k_EEPROM_magic1;
@@ -38,12 +44,14 @@ void erase_all(void)
 
     // add a sentinal directly after the header
     write_sentinal(sizeof(struct EEPROM_header));
+    storage_flush();
 }
 
 
+// writes may be deferred by the backend, callers flush once they are done
 void eeprom_write_check(const void *ptr, uint16_t ofs, uint8_t size)
 {
-    write_block(ofs, ptr, size);
+    storage_write(ofs, ptr, size);
 }
 
 // write a sentinal value at the given offset
@@ -55,16 +63,36 @@ void write_sentinal(uint16_t ofs)
     eeprom_write_check(&phdr, ofs, sizeof(phdr));
 }
 
-void init_param_lib(const Info *var_infop) {
+static void load_defaults(void) {
+    for(uint16_t i = 0; i < _num_vars; i++) {
+        uint8_t type = _var_info[i].type;
+        if(type <= AP_PARAM_FLOAT) {
+            ptrdiff_t base;
+            if(get_base(&_var_info[i], &base)) {
+                set_value((ap_var_type)type, (void*) base, _var_info[i].def_value);
+            }
+        }
+    }
+}
+
+// Returns false if the storage is not usable, all parameters are at
+// their defaults then and loads and saves fail
+bool init_param_lib(const Info *var_infop) {
     // Init library
     _var_info = var_infop;
     uint16_t i;
     for(i = 0; _var_info[i].type != AP_PARAM_NONE; i++);
     _num_vars = i;
 
+    storage_ok = init_storage();
+    if(!storage_ok) {
+        load_defaults();
+        return false;
+    }
+
     //Check for eeprom header
     EEPROM_header hdr;
-    read_block(&hdr, 0, sizeof(hdr));
+    storage_read(&hdr, 0, sizeof(hdr));
     if(hdr.magic[0] != k_EEPROM_magic0 ||
        hdr.magic[1] != k_EEPROM_magic1 ||
        hdr.revision != k_EEPROM_revision) {
@@ -73,16 +101,8 @@ void init_param_lib(const Info *var_infop) {
     }
 
     //Load all defaults
-    for(uint16_t i = 0; i < _num_vars; i++) {
-        uint8_t type = _var_info[i].type;
-        if(type <= AP_PARAM_FLOAT) {
-            ptrdiff_t base;
-            if(get_base(&_var_info[i], &base)) {
-                set_value((ap_var_type)type, (void*) base, _var_info[i].def_value);
-            }
-        }
-    }
-
+    load_defaults();
+    return true;
 }
 
 // return the storage size for a AP_PARAM_* type
@@ -119,7 +139,7 @@ bool duplicate_key(uint16_t vindex, uint16_t key)
 bool check_var_info(void) {
     uint16_t total_size = sizeof(struct EEPROM_header);
 
-    for(uint16_t i; i < _num_vars; i++) {
+    for(uint16_t i = 0; i < _num_vars; i++) {
         uint8_t type = _var_info[i].type;
         uint16_t key = _var_info[i].key;
         if(type != AP_PARAM_GROUP) {
@@ -178,7 +198,7 @@ bool load_value_using_pointer(const void * ptr) {
         return false;
     }
 
-    read_block(info->ptr, ofs+sizeof(phdr), type_size((ap_var_type)phdr.type));
+    storage_read(info->ptr, ofs+sizeof(phdr), type_size((ap_var_type)phdr.type));
     return true;
 }
 
@@ -190,8 +210,13 @@ bool load_value_using_pointer(const void * ptr) {
 bool scan(const Param_header *target, uint16_t *pofs) {
     Param_header phdr;
     uint16_t ofs = sizeof(EEPROM_header);
-    while(ofs < EEPROM_SIZE) {
-        read_block(&phdr, ofs, sizeof(phdr));
+
+    if(!storage_ok) {
+        *pofs = 0xFFFF;
+        return false;
+    }
+    while(ofs < storage_size()) {
+        storage_read(&phdr, ofs, sizeof(phdr));
         if(phdr.type == target->type &&
            phdr.key == target->key) {
             // found header
@@ -262,6 +287,7 @@ bool save_parameter(const void * ptr, bool force_save) {
     if(scan(&phdr, &ofs)) {
         // found an existing copy of the variable
         eeprom_write_check(info->ptr, ofs+sizeof(phdr), type_size((ap_var_type)phdr.type));
+        storage_flush();
         send_parameter(info, info->name, info->type);
         return true;
     }
@@ -286,7 +312,7 @@ bool save_parameter(const void * ptr, bool force_save) {
         }
     }
 
-    if(ofs+type_size((ap_var_type)phdr.type) + 2*sizeof(phdr) >= EEPROM_SIZE) {
+    if(ofs+type_size((ap_var_type)phdr.type) + 2*sizeof(phdr) >= storage_size()) {
         //We are out of EEPROM space
         //TODO: debug messages
         return false;
@@ -295,6 +321,8 @@ bool save_parameter(const void * ptr, bool force_save) {
     write_sentinal(ofs + sizeof(phdr) + type_size((ap_var_type)phdr.type));
     eeprom_write_check(info->ptr, ofs+sizeof(phdr), type_size((ap_var_type)phdr.type));
     eeprom_write_check(&phdr, ofs, sizeof(phdr));
+    // sentinal, value and header usually share a page, one physical write
+    storage_flush();
 
     send_parameter(info, info->name, info->type);
     return true;
@@ -346,8 +374,11 @@ bool load_all_parameters(void) {
     Param_header phdr;
     uint16_t ofs = sizeof(EEPROM_header);
 
-    while(ofs < EEPROM_SIZE) {
-        read_block(&phdr, ofs, sizeof(phdr));
+    if(!storage_ok)
+        return false;
+
+    while(ofs < storage_size()) {
+        storage_read(&phdr, ofs, sizeof(phdr));
         if(is_sentinal(&phdr)) {
             //we've reached the sentinal
             return true;
@@ -358,7 +389,7 @@ bool load_all_parameters(void) {
 
         info = find_by_header(phdr, &ptr);
         if(info != NULL) {
-            read_block(ptr, ofs+sizeof(phdr), type_size((ap_var_type)phdr.type));
+            storage_read(ptr, ofs+sizeof(phdr), type_size((ap_var_type)phdr.type));
         }
         ofs += type_size((ap_var_type)phdr.type) + sizeof(phdr);
     }
@@ -85,7 +85,7 @@ static const uint8_t        k_EEPROM_revision    = 1; ///< current format revisi
 static const uint16_t       _sentinal_key   = 0x7FF;
 static const uint8_t        _sentinal_type  = 0x1F;
 
-void init_param_lib(const Info *var_infop);
+bool init_param_lib(const Info *var_infop);
 bool check_var_info(void);
 bool load_value_using_pointer(const void * ptr);
 bool set_and_save_using_pointer(const void * ptr, float value, bool force_save);
@@ -4,6 +4,7 @@
 #include "parameters_d.h"
 #include "parameters.h"
 #include "telemetry.h"
+#include "led.h"
 
 #define GSCALAR(t, v, name, def) { t, name, k_param_ ## v, &v, def , 0}
 #define GSCALARA(t, v, arr, name, def) { t, name, k_param_ ## v, &arr, def , 0} //for array type
@@ -19,6 +20,7 @@ float target_voltage;
 float volt_lpf_beta;
 int16_t pid_report;
 float max_man_thr;
+rc_filter_config_t rc_filter_cfg;
 
 
 const struct Info var_info[] = {
@@ -72,7 +74,7 @@ const struct Info var_info[] = {
 
         // @Param: SR_PID_CONT
         // @DisplayName: PID controller stream frequency
-        // @Description: This is frequency of PID controller streams
+        // @Description: This is frequency of PID controller stream messages, each carries the queued samples that fit in one DATA96, 2 to about 6
         // @User: Advanced
         GSCALARA(AP_PARAM_INT16, stream_controller, stream_rates[STREAM_RAW_CONTROLLER], "SR_PID_CONT", 10),
 
@@ -108,7 +110,7 @@ const struct Info var_info[] = {
 
         // @Param: PID_REPORT
         // @DisplayName: Which PID controller is reported to GCS
-        // @Description: 1 - RPM, 0 - Voltage
+        // @Description: 2 - Open loop drive, 1 - RPM, 0 - Voltage
         // @User: Advanced
         GSCALAR(AP_PARAM_INT16, pid_report, "PID_REPORT", 0),
 
@@ -118,16 +120,61 @@ const struct Info var_info[] = {
         // @User: Advanced
         GSCALAR(AP_PARAM_FLOAT, max_man_thr, "MAX_MAN_THR", 0.05f),
 
+        // @Param: RC_FILT_MEDIAN
+        // @DisplayName: RC input median filter
+        // @Description: 1 - median of last 3 samples (rejects single glitches, one sample delay), 0 - off
+        // @User: Advanced
+        GSCALARA(AP_PARAM_INT16, rc_filt_median, rc_filter_cfg.median, "RC_FILT_MEDIAN", 1),
+
+        // @Param: RC_RATE_MAX
+        // @DisplayName: RC input rate limit
+        // @Description: Max change of RC input per sample in us, 0 - off
+        // @User: Advanced
+        GSCALARA(AP_PARAM_INT16, rc_rate_max, rc_filter_cfg.rate_max, "RC_RATE_MAX", 0),
+
+        // @Param: RC_DEADBAND
+        // @DisplayName: RC input deadband
+        // @Description: Deadband around center in us, 0 - off
+        // @User: Advanced
+        GSCALARA(AP_PARAM_INT16, rc_deadband, rc_filter_cfg.deadband, "RC_DEADBAND", 0),
+
+        // @Param: RC_EXPO
+        // @DisplayName: RC input expo
+        // @Description: Expo curve (0-100%), 0 - linear
+        // @User: Advanced
+        GSCALARA(AP_PARAM_INT16, rc_expo, rc_filter_cfg.expo, "RC_EXPO", 0),
+
+        // @Param: SR_SYSTEM
+        // @DisplayName: System stream frequency
+        // @Description: This is frequency of system load and per thread CPU and stack stream
+        // @User: Advanced
+        GSCALARA(AP_PARAM_INT16, stream_system, stream_rates[STREAM_SYSTEM], "SR_SYSTEM", 2),
+
+        // @Param: SR_TRACE
+        // @DisplayName: Trace dump stream frequency
+        // @Description: This is frequency of kernel and RC edge trace messages while a requested dump is sent
+        // @User: Advanced
+        GSCALARA(AP_PARAM_INT16, stream_trace, stream_rates[STREAM_TRACE], "SR_TRACE", 20),
+
 
         AP_VAREND,
 };
 
 
 void load_parameters(void) {
-    init_param_lib(var_info);
+    bool storage_ok;
+
+    led_set_state(LED_STATE_PARAMS_PENDING, true);
+    storage_ok = init_param_lib(var_info);
     if(!check_var_info()) {
         chSysHalt("Bad var_info table");
     }
+    if(!storage_ok) {
+        // run on the defaults, nothing can be loaded or saved
+        led_set_state(LED_STATE_EEPROM_ERROR, true);
+        led_set_state(LED_STATE_PARAMS_PENDING, false);
+        return;
+    }
 
     if(!load_value_using_pointer(&format_version) ||
             format_version != k_format_version) {
@@ -138,7 +185,10 @@ void load_parameters(void) {
         set_and_save_using_pointer(&format_version, (float)k_format_version, false);
         //save the current format version
     }
-    load_all_parameters();
-
+    if(!load_all_parameters()) {
+        // the values that failed to load stay at their defaults
+        led_set_state(LED_STATE_EEPROM_ERROR, true);
+    }
+    led_set_state(LED_STATE_PARAMS_PENDING, false);
 }
 
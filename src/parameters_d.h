@@ -6,6 +6,7 @@
 #include "parameters.h"
 #include "parameters_d.h"
 #include "telemetry.h"
+#include "rc_filter.h"
 
 //////////////////////////////////////////////////////////////////
 // STOP!!! DO NOT CHANGE THIS VALUE UNTIL YOU FULLY UNDERSTAND THE
@@ -32,6 +33,12 @@ enum {
     k_param_volt_lpf_beta,
     k_param_pid_report,
     k_param_max_man_thr,
+    k_param_rc_filt_median,
+    k_param_rc_rate_max,
+    k_param_rc_deadband,
+    k_param_rc_expo,
+    k_param_stream_system,
+    k_param_stream_trace,
 };
 
 
@@ -46,6 +53,7 @@ extern float target_voltage;
 extern float volt_lpf_beta;
 extern int16_t pid_report;
 extern float max_man_thr;
+extern rc_filter_config_t rc_filter_cfg;
 
 void load_parameters(void);
 
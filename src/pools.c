@@ -0,0 +1,74 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "pools.h"
+
+static obj_pool_t *pools[POOLS_MAX];
+static uint8_t num_pools = 0;
+
+// Load the objects into the pool and register it for reporting
+void init_pool(obj_pool_t *pool) {
+    chPoolLoadArray(&pool->mp, pool->objects, pool->count);
+    if(num_pools < POOLS_MAX)
+        pools[num_pools++] = pool;
+}
+
+void *pool_allocI(obj_pool_t *pool) {
+    void *obj;
+
+    chDbgCheckClassI();
+    obj = chPoolAllocI(&pool->mp);
+    if(obj == NULL) {
+        pool->exhausted++;
+        return NULL;
+    }
+    if(++pool->in_use > pool->max_in_use)
+        pool->max_in_use = pool->in_use;
+    return obj;
+}
+
+void *pool_alloc(obj_pool_t *pool) {
+    void *obj;
+
+    chSysLock();
+    obj = pool_allocI(pool);
+    chSysUnlock();
+    return obj;
+}
+
+// Any context, thread or ISR
+void *pool_allocX(obj_pool_t *pool) {
+    void *obj;
+
+    syssts_t sts = chSysGetStatusAndLockX();
+    obj = pool_allocI(pool);
+    chSysRestoreStatusX(sts);
+    return obj;
+}
+
+void pool_freeI(obj_pool_t *pool, void *obj) {
+    chDbgCheckClassI();
+    chPoolFreeI(&pool->mp, obj);
+    pool->in_use--;
+}
+
+void pool_free(obj_pool_t *pool, void *obj) {
+    chSysLock();
+    pool_freeI(pool, obj);
+    chSysUnlock();
+}
+
+// Any context, thread or ISR
+void pool_freeX(obj_pool_t *pool, void *obj) {
+    syssts_t sts = chSysGetStatusAndLockX();
+    pool_freeI(pool, obj);
+    chSysRestoreStatusX(sts);
+}
+
+uint8_t pools_count(void) {
+    return num_pools;
+}
+
+const obj_pool_t *pools_get(uint8_t i) {
+    return i < num_pools ? pools[i] : NULL;
+}
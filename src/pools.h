@@ -0,0 +1,44 @@
+#ifndef SRC_POOLS_H_
+#define SRC_POOLS_H_
+
+#include "ch.h"
+#include "hal.h"
+
+/*
+ * Fixed size object pools on top of ChibiOS memory pools. Objects come
+ * from a static array, alloc and free are O(1). The I variants need the
+ * kernel locked, the X variants lock it themselves and are callable from
+ * threads and ISRs alike. Usage high-water marks and
+ * failed allocations are kept per pool and reported on the SR_SYSTEM
+ * stream. Nothing in the firmware allocates from the heap.
+ */
+#define POOLS_MAX           4
+
+typedef struct {
+    memory_pool_t mp;
+    const char *name;
+    void *objects;
+    size_t size;
+    uint16_t count;
+    uint16_t in_use;
+    uint16_t max_in_use;    // high-water mark
+    uint32_t exhausted;     // allocations that failed
+} obj_pool_t;
+
+// Defines pool var of n objects of type, local to the file
+#define POOL_DEF(var, name, type, n)                                        \
+    static type var##_objects[n];                                           \
+    static obj_pool_t var = { _MEMORYPOOL_DATA(var.mp, sizeof(type), NULL),       \
+                       name, var##_objects, sizeof(type), n, 0, 0, 0 }
+
+void init_pool(obj_pool_t *pool);
+void *pool_allocI(obj_pool_t *pool);
+void *pool_alloc(obj_pool_t *pool);
+void *pool_allocX(obj_pool_t *pool);
+void pool_freeI(obj_pool_t *pool, void *obj);
+void pool_free(obj_pool_t *pool, void *obj);
+void pool_freeX(obj_pool_t *pool, void *obj);
+uint8_t pools_count(void);
+const obj_pool_t *pools_get(uint8_t i);
+
+#endif /* SRC_POOLS_H_ */
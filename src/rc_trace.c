@@ -0,0 +1,135 @@
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "mavlink_bridge.h"
+#include "mavlink.h"
+
+#include "rc_trace.h"
+#include "rc_input.h"
+
+#define HEADER_SIZE         8
+#define FRAME_SIZE          96      // DATA96 payload
+#define EVENTS_PER_FRAME    ((FRAME_SIZE - HEADER_SIZE) / sizeof(rc_trace_event_t))
+
+#if RC_CHECK
+
+#if RC_TRACE_EVENTS > 65535
+#error "The trace dump indexes events with a halfword"
+#endif
+
+typedef enum {
+    TRACE_IDLE = 0,
+    TRACE_CAPTURING,
+    TRACE_SENDING
+} trace_state_t;
+
+static rc_trace_event_t events[RC_TRACE_EVENTS];
+static uint16_t capture_size;
+static uint16_t num_events;
+static uint16_t send_pos;
+static uint8_t dump_id = 0;
+static trace_state_t state = TRACE_IDLE;
+// state changes from the mavlink_rx and telemetry threads
+static MUTEX_DECL(trace_mtx);
+
+// Ends the capture and queues the recorded events for sending
+static void finish_capture(void) {
+    num_events = rc_trace_stop();
+    send_pos = 0;
+    dump_id++;
+    state = TRACE_SENDING;
+}
+
+/*
+ * Start recording events, 0 stops a running capture early. Returns false
+ * while the previous trace is still being sent. Called from the
+ * mavlink_rx thread.
+ */
+bool rc_trace_request(uint16_t n) {
+    bool ok = true;
+
+    chMtxLock(&trace_mtx);
+    if(n == 0) {
+        if(state == TRACE_CAPTURING)
+            finish_capture();
+        else
+            ok = false;
+    } else if(state == TRACE_IDLE) {
+        capture_size = n < RC_TRACE_EVENTS ? n : RC_TRACE_EVENTS;
+        state = TRACE_CAPTURING;
+        rc_trace_start(events, capture_size);
+    } else {
+        ok = false;
+    }
+    chMtxUnlock(&trace_mtx);
+    return ok;
+}
+
+bool rc_trace_active(void) {
+    return state != TRACE_IDLE;
+}
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+/*
+ * SR_TRACE stream, one DATA96 of the recorded trace per call once the
+ * capture is complete. Sends nothing otherwise.
+ */
+uint16_t rc_trace_send(const mavlink_links_t *links) {
+    uint8_t data[FRAME_SIZE];
+    uint16_t n;
+
+    chMtxLock(&trace_mtx);
+    if(state == TRACE_CAPTURING && rc_trace_count() >= capture_size)
+        finish_capture();
+    if(state != TRACE_SENDING) {
+        chMtxUnlock(&trace_mtx);
+        return 0;
+    }
+
+    n = num_events - send_pos;
+    if(n > EVENTS_PER_FRAME)
+        n = EVENTS_PER_FRAME;
+    memset(data, 0, sizeof(data));
+    data[0] = dump_id;
+    data[1] = n;
+    put_u16(data + 2, send_pos);
+    put_u16(data + 4, num_events);
+    data[6] = RC_INPUT_MODE;
+    memcpy(data + HEADER_SIZE, &events[send_pos], n * sizeof(rc_trace_event_t));
+    send_pos += n;
+    if(send_pos >= num_events)
+        state = TRACE_IDLE;
+    chMtxUnlock(&trace_mtx);
+
+    for(uint8_t i = 0; i < links->n; i++) {
+        mavlink_lock(links->chan[i]);
+        mavlink_msg_data96_send(links->chan[i], RC_TRACE_DATA_TYPE,
+                HEADER_SIZE + n * sizeof(rc_trace_event_t), data);
+        mavlink_unlock(links->chan[i]);
+    }
+    return MAVLINK_MSG_ID_DATA96_LEN + MAVLINK_NUM_NON_PAYLOAD_BYTES;
+}
+
+#else /* !RC_CHECK */
+
+bool rc_trace_request(uint16_t n) {
+    (void) n;
+    return false;
+}
+
+bool rc_trace_active(void) {
+    return false;
+}
+
+uint16_t rc_trace_send(const mavlink_links_t *links) {
+    (void) links;
+    return 0;
+}
+
+#endif
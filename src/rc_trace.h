@@ -0,0 +1,32 @@
+#ifndef SRC_RC_TRACE_H_
+#define SRC_RC_TRACE_H_
+
+#include "ch.h"
+#include "hal.h"
+
+#include "mavlink_bridge.h"
+#include "rc_check.h"
+
+/*
+ * Capture of the live RC edges for replay on the host (RC_CHECK builds).
+ * MAV_CMD_USER_4 with param1 events starts the recorder, param1 0 stops
+ * it early. The recorder stops by itself when the buffer is full, the
+ * trace is then sent on the SR_TRACE stream as DATA96 messages, type
+ * RC_TRACE_DATA_TYPE, each starting with
+ *   u8 dump id, u8 events, u16 index of the first event,
+ *   u16 total events, u8 RC_INPUT_MODE, u8 reserved
+ * followed by the events as rc_trace_event_t, 8 bytes each.
+ * tools/rc_trace_dump.py writes the trace of a tlog to a file that
+ * test/rc_replay decodes.
+ */
+#define RC_TRACE_DATA_TYPE      0x52
+
+#ifndef RC_TRACE_EVENTS
+#define RC_TRACE_EVENTS         128
+#endif
+
+bool rc_trace_request(uint16_t events);
+bool rc_trace_active(void);
+uint16_t rc_trace_send(const mavlink_links_t *links);
+
+#endif /* SRC_RC_TRACE_H_ */
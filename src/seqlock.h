@@ -0,0 +1,45 @@
+#ifndef SRC_SEQLOCK_H_
+#define SRC_SEQLOCK_H_
+
+#include "ch.h"
+#include "hal.h"
+
+/*
+ * Sequence lock for data written from ISRs and read from threads. Readers
+ * never block the writer, they retry when the sequence changed while they
+ * copied. The sequence is odd while a write is in progress.
+ *
+ * Writers must be serialized (ISR context with the kernel lock held) and
+ * readers must not preempt a writer, so don't read from ISRs.
+ */
+typedef struct {
+    volatile uint32_t seq;
+} seqlock_t;
+
+#define SEQLOCK_INIT    { 0 }
+
+static inline void seqlock_write_begin(seqlock_t *sl) {
+    sl->seq++;
+    __DMB();
+}
+
+static inline void seqlock_write_end(seqlock_t *sl) {
+    __DMB();
+    sl->seq++;
+}
+
+static inline uint32_t seqlock_read_begin(const seqlock_t *sl) {
+    uint32_t seq;
+    while((seq = sl->seq) & 1)
+        ;
+    __DMB();
+    return seq;
+}
+
+// true if the data read since seqlock_read_begin() must be read again
+static inline bool seqlock_read_retry(const seqlock_t *sl, uint32_t seq) {
+    __DMB();
+    return sl->seq != seq;
+}
+
+#endif /* SRC_SEQLOCK_H_ */
@@ -0,0 +1,154 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "supervisor.h"
+#include "timebase.h"
+
+#define RECORD_MAGIC    0x5344  // "SD"
+
+// LSI / 16 = 2.5 kHz at the nominal 40 kHz
+static const WDGConfig wdgcfg = {
+    STM32_IWDG_PR_16,
+    STM32_IWDG_RL(SUPERVISOR_IWDG_MS * 40000 / 16 / 1000)
+};
+
+static supervisor_client_t clients[SUPERVISOR_MAX_CLIENTS];
+static uint8_t num_clients = 0;
+static virtual_timer_t check_vt;
+static bool missed = false;
+static uint8_t paused = 0;
+static supervisor_reset_t last_reset;
+
+/*
+ * Miss record in the backup domain, survives the watchdog reset:
+ * DR1 magic, DR2 client, DR3/DR4 thread name pointer, DR5/DR6 late us.
+ */
+static void record_miss(uint8_t client, thread_t *tp, uint32_t late_us) {
+    uint32_t name = (uint32_t)chRegGetThreadNameX(tp);
+
+    BKP->DR2 = client;
+    BKP->DR3 = name & 0xFFFF;
+    BKP->DR4 = name >> 16;
+    BKP->DR5 = late_us & 0xFFFF;
+    BKP->DR6 = late_us >> 16;
+    BKP->DR1 = RECORD_MAGIC;
+}
+
+static void read_record(void) {
+    last_reset.watchdog = (RCC->CSR & RCC_CSR_IWDGRSTF) != 0;
+    RCC->CSR |= RCC_CSR_RMVF;
+
+    if(BKP->DR1 != RECORD_MAGIC)
+        return;
+    last_reset.hard_miss = last_reset.watchdog;
+    last_reset.client = BKP->DR2;
+    last_reset.thread = (const char *)(BKP->DR3 | ((uint32_t)BKP->DR4 << 16));
+    last_reset.late_us = BKP->DR5 | ((uint32_t)BKP->DR6 << 16);
+    BKP->DR1 = 0;
+}
+
+static void check_cb(void *arg) {
+    uint32_t now = micros();
+    (void) arg;
+
+    chSysLockFromISR();
+    for(uint8_t i = 0; i < num_clients && !missed && paused == 0; i++) {
+        uint32_t late = now - clients[i].timeout_from;
+        if(late > clients[i].timeout_us) {
+            // the interrupted thread is the one that kept the client from running
+            record_miss(i, chThdGetSelfX(), late);
+            missed = true;
+        }
+    }
+    if(!missed)
+        wdgResetI(&WDGD1);
+    chVTSetI(&check_vt, MS2ST(SUPERVISOR_CHECK_MS), check_cb, NULL);
+    chSysUnlockFromISR();
+}
+
+void init_supervisor(void) {
+    // backup domain access for the miss record
+    rccEnableAPB1(RCC_APB1ENR_PWREN | RCC_APB1ENR_BKPEN, FALSE);
+    PWR->CR |= PWR_CR_DBP;
+    read_record();
+
+    // keep the watchdog stopped while the core is halted by the debugger
+    DBGMCU->CR |= DBGMCU_CR_DBG_IWDG_STOP;
+    wdgStart(&WDGD1, &wdgcfg);
+
+    chVTObjectInit(&check_vt);
+    chVTSet(&check_vt, MS2ST(SUPERVISOR_CHECK_MS), check_cb, NULL);
+}
+
+/*
+ * Register a client, returns its id or -1. Overruns are counted past
+ * deadline_us, past timeout_us the board is reset.
+ */
+int8_t supervisor_register(const char *name, uint32_t deadline_us, uint32_t timeout_us) {
+    int8_t id = -1;
+
+    chSysLock();
+    if(num_clients < SUPERVISOR_MAX_CLIENTS) {
+        id = num_clients;
+        clients[id].name = name;
+        clients[id].deadline_us = deadline_us;
+        clients[id].timeout_us = timeout_us;
+        clients[id].last_checkin = micros();
+        clients[id].timeout_from = clients[id].last_checkin;
+        num_clients++;
+    }
+    chSysUnlock();
+    return id;
+}
+
+void supervisor_checkin(int8_t id) {
+    supervisor_client_t *c;
+    uint32_t now = micros();
+
+    if(id < 0 || id >= num_clients)
+        return;
+    c = &clients[id];
+    uint32_t period = now - c->last_checkin;
+    c->last_checkin = now;
+    c->timeout_from = now;
+    if(c->checkins++ == 0)
+        return;     // first period starts at registration
+    if(period > c->max_period_us)
+        c->max_period_us = period;
+    if(period > c->deadline_us)
+        c->overruns++;
+}
+
+// Suspend the timeout checks around a CPU stall, calls nest
+void supervisor_pause(void) {
+    chSysLock();
+    paused++;
+    chSysUnlock();
+}
+
+// Timeouts restart from now, the clients didn't get to run while paused
+void supervisor_resume(void) {
+    uint32_t now = micros();
+
+    chSysLock();
+    if(paused > 0 && --paused == 0) {
+        for(uint8_t i = 0; i < num_clients; i++)
+            clients[i].timeout_from = now;
+    }
+    chSysUnlock();
+}
+
+const supervisor_client_t *supervisor_get_client(uint8_t id) {
+    return id < num_clients ? &clients[id] : NULL;
+}
+
+const supervisor_reset_t *supervisor_get_reset(void) {
+    return &last_reset;
+}
+
+uint32_t supervisor_overruns(void) {
+    uint32_t n = 0;
+    for(uint8_t i = 0; i < num_clients; i++)
+        n += clients[i].overruns;
+    return n;
+}
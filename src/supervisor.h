@@ -0,0 +1,56 @@
+#ifndef SRC_SUPERVISOR_H_
+#define SRC_SUPERVISOR_H_
+
+#include "ch.h"
+#include "hal.h"
+
+/*
+ * Deadline supervisor on the independent watchdog. Critical tasks
+ * register with a deadline and a timeout and check in every cycle.
+ * A check-in later than the deadline is an overrun, counted together
+ * with the longest period seen. A virtual timer checks all clients every
+ * SUPERVISOR_CHECK_MS and feeds the IWDG only while none of them is past
+ * its timeout. On the first hard miss the thread that was running is
+ * recorded in the backup registers and the IWDG resets the board, the
+ * record is available after the reset through supervisor_get_reset().
+ *
+ * Code that stalls the CPU on purpose pauses the timeout checks instead
+ * of every timeout being raised above the stall: a flash page erase takes
+ * 20-40 ms, longer than the control loop timeout. The IWDG is still fed
+ * while paused, so a stall longer than SUPERVISOR_IWDG_MS resets the
+ * board, and the check-in after the pause still counts the overrun.
+ */
+#define SUPERVISOR_MAX_CLIENTS  4
+#define SUPERVISOR_CHECK_MS     5
+#define SUPERVISOR_IWDG_MS      100     // LSI is 30-60 kHz, 50-200 ms
+
+typedef struct {
+    const char *name;
+    uint32_t deadline_us;
+    uint32_t timeout_us;
+    uint32_t last_checkin;      // micros()
+    uint32_t timeout_from;      // micros(), last check-in or end of a pause
+    uint32_t checkins;
+    uint32_t overruns;
+    uint32_t max_period_us;
+} supervisor_client_t;
+
+// What caused the last watchdog reset
+typedef struct {
+    bool watchdog;              // last reset was the IWDG
+    bool hard_miss;             // the supervisor let it expire
+    uint8_t client;             // client that missed its timeout
+    const char *thread;         // thread running at the miss, NULL if unknown
+    uint32_t late_us;           // time since the client's last check-in
+} supervisor_reset_t;
+
+void init_supervisor(void);
+int8_t supervisor_register(const char *name, uint32_t deadline_us, uint32_t timeout_us);
+void supervisor_checkin(int8_t id);
+void supervisor_pause(void);
+void supervisor_resume(void);
+const supervisor_client_t *supervisor_get_client(uint8_t id);
+const supervisor_reset_t *supervisor_get_reset(void);
+uint32_t supervisor_overruns(void);
+
+#endif /* SRC_SUPERVISOR_H_ */
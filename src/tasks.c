@@ -0,0 +1,91 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "tasks.h"
+#include "timebase.h"
+#include "supervisor.h"
+#include "led.h"
+
+static const task_t *tasks[TASKS_MAX];
+static task_stats_t stats[TASKS_MAX];
+static uint8_t num_tasks = 0;
+static systime_t start_time;
+
+static THD_FUNCTION(task_thread, arg) {
+    uint8_t i = (uint8_t)(uint32_t)arg;
+    const task_t *task = tasks[i];
+    task_stats_t *st = &stats[i];
+    systime_t period = TIMEBASE_US2ST(task->period_us);
+    systime_t release = start_time;
+    int8_t sup = -1;
+
+    chRegSetThreadName(task->name);
+    if(task->timeout_us > 0)
+        sup = supervisor_register(task->name, 2 * task->period_us, task->timeout_us);
+    while(true) {
+        chThdSleepUntilWindowed(release - period, release);
+
+        chTMStartMeasurementX(&st->exec_tm);
+        task->fn();
+        chTMStopMeasurementX(&st->exec_tm);
+        st->runs++;
+        supervisor_checkin(sup);
+
+        // deadline is the next release
+        release += period;
+        systime_t now = chVTGetSystemTimeX();
+        if(!chVTIsTimeWithinX(now, release - period, release)) {
+            st->overruns++;
+            led_set_state(LED_STATE_OVERRUN, true);
+            release = now + period;
+        }
+    }
+}
+
+// Register a task, only before tasks_start()
+bool tasks_add(const task_t *task) {
+    if(num_tasks >= TASKS_MAX || task->period_us == 0 ||
+            TIMEBASE_US2ST(task->period_us) > TIME_INFINITE / 2)
+        return false;
+    tasks[num_tasks++] = task;
+    return true;
+}
+
+void tasks_start(void) {
+    start_time = chVTGetSystemTime();
+
+    for(uint8_t i = 0; i < num_tasks; i++) {
+        // one priority level per distinct faster period
+        uint8_t faster = 0;
+        for(uint8_t j = 0; j < num_tasks; j++) {
+            bool counted = false;
+            if(tasks[j]->period_us >= tasks[i]->period_us)
+                continue;
+            for(uint8_t k = 0; k < j; k++) {
+                if(tasks[k]->period_us == tasks[j]->period_us)
+                    counted = true;
+            }
+            if(!counted)
+                faster++;
+        }
+        stats[i].prio = TASKS_PRIO_TOP - faster;
+        chTMObjectInit(&stats[i].exec_tm);
+    }
+
+    for(uint8_t i = 0; i < num_tasks; i++) {
+        stats[i].thread = chThdCreateStatic(tasks[i]->wa, tasks[i]->wa_size,
+                stats[i].prio, task_thread, (void *)(uint32_t)i);
+    }
+}
+
+uint8_t tasks_count(void) {
+    return num_tasks;
+}
+
+const task_t *tasks_get(uint8_t i, const task_stats_t **st) {
+    if(i >= num_tasks)
+        return NULL;
+    if(st != NULL)
+        *st = &stats[i];
+    return tasks[i];
+}
@@ -0,0 +1,62 @@
+#ifndef SRC_TASKS_H_
+#define SRC_TASKS_H_
+
+#include "ch.h"
+#include "hal.h"
+
+/*
+ * Periodic tasks. Each task runs in its own thread, released on an
+ * absolute time grid so the period doesn't drift with execution time.
+ * Priorities are rate monotonic, assigned by tasks_start() from the
+ * periods: the shorter the period the higher the priority, so adding a
+ * slower task never delays a faster one.
+ *
+ * A release that finishes after the next release time is an overrun, the
+ * missed releases are skipped and the grid restarts from now.
+ *
+ * Periods must be below half the system time range, see timebase.h.
+ */
+#ifndef TASKS_MAX
+#define TASKS_MAX           8
+#endif
+// Priority of the fastest task, the others get consecutive lower ones
+#define TASKS_PRIO_TOP      (NORMALPRIO + 20)
+
+typedef void (*task_fn_t)(void);
+
+typedef struct {
+    const char *name;
+    task_fn_t fn;
+    uint32_t period_us;
+    uint32_t timeout_us;        // supervisor timeout, 0 for unsupervised
+    stkalign_t *wa;
+    size_t wa_size;
+} task_t;
+
+typedef struct {
+    uint32_t runs;
+    uint32_t overruns;
+    time_measurement_t exec_tm;
+    thread_t *thread;
+    tprio_t prio;
+} task_stats_t;
+
+// Defines task var with its working area of stack_size bytes
+#define TASK_DEF(var, name, fn, period_us, stack_size)                      \
+    TASK_DEF_SUPERVISED(var, name, fn, period_us, stack_size, 0)
+
+/*
+ * Same for a critical task, it checks in with the supervisor every run.
+ * Two periods between runs count as an overrun, timeout_us resets the board.
+ */
+#define TASK_DEF_SUPERVISED(var, name, fn, period_us, stack_size, timeout_us) \
+    static THD_WORKING_AREA(var##_wa, stack_size);                         \
+    static const task_t var = { name, fn, period_us, timeout_us,           \
+                                var##_wa, sizeof(var##_wa) }
+
+bool tasks_add(const task_t *task);
+void tasks_start(void);
+uint8_t tasks_count(void);
+const task_t *tasks_get(uint8_t i, const task_stats_t **stats);
+
+#endif /* SRC_TASKS_H_ */
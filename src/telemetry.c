@@ -0,0 +1,422 @@
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "mavlink_bridge.h"
+#include "mavlink.h"
+
+#include "telemetry.h"
+#include "parameters.h"
+#include "parameters_d.h"
+#include "rc_input.h"
+#include "tune_log.h"
+#include "monitor.h"
+#include "kernel_trace.h"
+#include "rc_trace.h"
+#include "tasks.h"
+#include "timebase.h"
+#include "pools.h"
+#include "topic.h"
+
+#define BYTES_PER_TICK          (MAVLINK_BAUD / 10 / TELEMETRY_TICK_HZ)
+#define MSG_SIZE(len)           ((len) + MAVLINK_NUM_NON_PAYLOAD_BYTES)
+
+/*
+ * Sends one message of the stream on every link, returns the bytes sent
+ * per link, 0 if nothing to send
+ */
+typedef uint16_t (*stream_send_t)(const mavlink_links_t *links);
+
+typedef struct {
+    stream_send_t send;
+    uint16_t max_len;           // largest message the stream sends
+    bool degradable;
+} stream_def_t;
+
+typedef struct {
+    systime_t next_due;
+    uint8_t good_slots;
+} stream_state_t;
+
+static uint16_t send_params(const mavlink_links_t *links);
+static uint16_t send_rc_channels(const mavlink_links_t *links);
+static uint16_t send_trace(const mavlink_links_t *links);
+
+/*
+ * Streams without a data source in this firmware yet have no send
+ * function, their slots are skipped.
+ */
+static const stream_def_t streams[NUM_STREAMS] = {
+    [STREAM_PARAMS]         = { send_params, MSG_SIZE(MAVLINK_MSG_ID_PARAM_VALUE_LEN), false },
+    [STREAM_RAW_SENSORS]    = { NULL, 0, true },
+    [STREAM_RC_CHANNELS]    = { send_rc_channels, MSG_SIZE(MAVLINK_MSG_ID_RC_CHANNELS_RAW_LEN), true },
+    [STREAM_RAW_CONTROLLER] = { tune_log_send, MSG_SIZE(MAVLINK_MSG_ID_DATA96_LEN), true },
+    [STREAM_SYSTEM]         = { monitor_send, MSG_SIZE(MAVLINK_MSG_ID_DATA32_LEN), true },
+    [STREAM_TRACE]          = { send_trace, MSG_SIZE(MAVLINK_MSG_ID_DATA96_LEN), true },
+};
+
+static telemetry_stats_t stats;
+static uint32_t budget = 0;     // bytes the link can take this tick
+static volatile uint32_t forwarded_bytes = 0;   // router, mavlink_rx thread
+static uint32_t forwarded_seen = 0;
+
+// Latest RC frame, from the telemetry thread's rc_frame_topic subscription
+#define TELEMETRY_EVT_RC        0
+static topic_sub_t rc_sub;
+static rc_frame_t rc_frame;
+static bool rc_subscribed = false;
+
+/*
+ * Messages queued by other threads for the telemetry thread, one queue
+ * per link plus one for MAVLINK_COMM_ALL, whose messages are sent on
+ * every link. Bounded lock-free MPSC queue, producers claim a cell with
+ * LDREX/STREX on head and publish it through the cell sequence, so
+ * queueing never blocks and is ISR safe. Messages themselves come from a
+ * pool shared by all links.
+ */
+#if (TELEMETRY_QUEUE_LEN & (TELEMETRY_QUEUE_LEN - 1)) != 0
+#error "TELEMETRY_QUEUE_LEN must be a power of two"
+#endif
+
+typedef struct {
+    char name[AP_MAX_NAME_SIZE];
+    float value;
+    uint16_t index;
+    uint8_t type;               // MAV_PARAM_TYPE_*
+} telem_msg_t;
+
+typedef struct {
+    volatile uint32_t seq;      // == position when free, position + 1 when full
+    telem_msg_t *msg;
+} telem_cell_t;
+
+typedef struct {
+    telem_cell_t cells[TELEMETRY_QUEUE_LEN];
+    volatile uint32_t head;     // next cell to claim, producers
+    uint32_t tail;              // next cell to send, telemetry thread
+} telem_queue_t;
+
+static telem_queue_t queues[MAVLINK_COMM_NUM_BUFFERS];
+POOL_DEF(msg_pool, "telem_msg", telem_msg_t, TELEMETRY_MSG_POOL_SIZE);
+
+static bool cas(volatile uint32_t *p, uint32_t old, uint32_t val) {
+    if(__LDREXW(p) != old) {
+        __CLREX();
+        return false;
+    }
+    return __STREXW(val, p) == 0;
+}
+
+static void atomic_inc(volatile uint32_t *p) {
+    uint32_t v;
+    do {
+        v = __LDREXW(p);
+    } while(__STREXW(v + 1, p) != 0);
+}
+
+static bool queue_push(mavlink_channel_t chan, telem_msg_t *msg) {
+    telem_queue_t *q = &queues[chan];
+    telem_cell_t *cell;
+    uint32_t pos;
+
+    do {
+        pos = q->head;
+        cell = &q->cells[pos % TELEMETRY_QUEUE_LEN];
+        if((int32_t)(cell->seq - pos) < 0) {
+            atomic_inc(&stats.queue_dropped[chan]);
+            return false;
+        }
+    } while(cell->seq != pos || !cas(&q->head, pos, pos + 1));
+
+    cell->msg = msg;
+    __DMB();
+    cell->seq = pos + 1;
+    return true;
+}
+
+static telem_msg_t *queue_peek(telem_queue_t *q) {
+    telem_cell_t *cell = &q->cells[q->tail % TELEMETRY_QUEUE_LEN];
+    if(cell->seq != q->tail + 1)
+        return NULL;
+    __DMB();
+    return cell->msg;
+}
+
+static void queue_pop(telem_queue_t *q) {
+    telem_cell_t *cell = &q->cells[q->tail % TELEMETRY_QUEUE_LEN];
+    __DMB();
+    cell->seq = q->tail + TELEMETRY_QUEUE_LEN;
+    q->tail++;
+}
+
+// Send queued messages ahead of the streams while the budget allows
+static void send_queued(const mavlink_links_t *links) {
+    for(uint8_t i = 0; i < MAVLINK_COMM_NUM_BUFFERS; i++) {
+        telem_msg_t *msg;
+        while(budget >= MSG_SIZE(MAVLINK_MSG_ID_PARAM_VALUE_LEN) &&
+                (msg = queue_peek(&queues[i])) != NULL) {
+            if(i != MAVLINK_COMM_ALL) {
+                mavlink_lock((mavlink_channel_t)i);
+                mavlink_msg_param_value_send((mavlink_channel_t)i, msg->name, msg->value,
+                        msg->type, count_parameters(), msg->index);
+                mavlink_unlock((mavlink_channel_t)i);
+            } else {
+                for(uint8_t j = 0; j < links->n; j++) {
+                    mavlink_lock(links->chan[j]);
+                    mavlink_msg_param_value_send(links->chan[j], msg->name, msg->value,
+                            msg->type, count_parameters(), msg->index);
+                    mavlink_unlock(links->chan[j]);
+                }
+            }
+            queue_pop(&queues[i]);
+            pool_free(&msg_pool, msg);
+            budget -= MSG_SIZE(MAVLINK_MSG_ID_PARAM_VALUE_LEN);
+            stats.used_bytes += MSG_SIZE(MAVLINK_MSG_ID_PARAM_VALUE_LEN);
+            stats.queued_sent++;
+        }
+    }
+}
+
+static stream_state_t state[NUM_STREAMS];
+
+// parameter list download, the iterator belongs to the telemetry thread
+static volatile bool param_list_request = false;
+static bool param_list_active = false;
+static ParamToken param_token;
+static const Info *param_next = NULL;
+static uint16_t param_index = 0;
+
+TASK_DEF(telemetry_task, "telemetry", telemetry_update, 1000000 / TELEMETRY_TICK_HZ, 512);
+
+// Registers the telemetry task, call before tasks_start()
+void init_telemetry(void) {
+    systime_t now = chVTGetSystemTime();
+    for(uint8_t i = 0; i < NUM_STREAMS; i++)
+        state[i].next_due = now;
+    for(uint8_t i = 0; i < MAVLINK_COMM_NUM_BUFFERS; i++) {
+        for(uint8_t j = 0; j < TELEMETRY_QUEUE_LEN; j++)
+            queues[i].cells[j].seq = j;
+    }
+    init_pool(&msg_pool);
+
+    if(!tasks_add(&telemetry_task))
+        chSysHalt("telemetry task");
+}
+
+// Wrap-safe now >= t
+static inline bool time_reached(systime_t now, systime_t t) {
+    return (systime_t)(now - t) < (systime_t)(TIME_INFINITE / 2);
+}
+
+// Capped at half the system time range, see timebase.h
+static inline systime_t stream_interval(uint8_t i) {
+    uint32_t interval = ((uint32_t)S2ST(1) / stream_rates[i]) << stats.streams[i].degrade;
+    if(interval > TIME_INFINITE / 2)
+        interval = TIME_INFINITE / 2;
+    return (systime_t)interval;
+}
+
+/*
+ * Bytes the router forwarded on a link, taken from the budget of the next
+ * tick. Called from the mavlink_rx thread only.
+ */
+void telemetry_account_bytes(uint16_t bytes) {
+    forwarded_bytes += bytes;
+}
+
+/*
+ * One scheduler tick. Queued messages go first, then due streams are served in priority order as long as
+ * their largest message fits in the byte budget of the link. Every message
+ * goes out on all links, the budget is that of one link. A slot that
+ * doesn't fit is dropped and the stream slows down, it speeds up again
+ * after TELEMETRY_RECOVER_SLOTS slots sent in a row. PARAMS never slows down.
+ */
+void telemetry_update(void) {
+    systime_t now = chVTGetSystemTime();
+
+    budget += BYTES_PER_TICK;
+    if(budget > BYTES_PER_TICK * TELEMETRY_BUDGET_CARRY)
+        budget = BYTES_PER_TICK * TELEMETRY_BUDGET_CARRY;
+    stats.ticks++;
+    stats.budget_bytes += BYTES_PER_TICK;
+
+    uint32_t forwarded = forwarded_bytes - forwarded_seen;
+    forwarded_seen += forwarded;
+    budget = budget > forwarded ? budget - forwarded : 0;
+    stats.used_bytes += forwarded;
+    stats.forwarded_bytes += forwarded;
+
+    mavlink_links_t links;
+    mavlink_get_links(&links);
+    if(links.n == 0)
+        return;
+
+    send_queued(&links);
+
+    for(uint8_t i = 0; i < NUM_STREAMS; i++) {
+        const stream_def_t *def = &streams[i];
+        stream_state_t *st = &state[i];
+        stream_stats_t *ss = &stats.streams[i];
+
+        if(def->send == NULL || stream_rates[i] <= 0)
+            continue;
+        if(!time_reached(now, st->next_due))
+            continue;
+
+        systime_t interval = stream_interval(i);
+        if(def->max_len <= budget) {
+            uint16_t bytes = def->send(&links);
+            budget -= bytes;
+            stats.used_bytes += bytes;
+            if(bytes > 0) {
+                ss->sent++;
+                ss->bytes += bytes;
+            }
+            if(ss->degrade > 0 && ++st->good_slots >= TELEMETRY_RECOVER_SLOTS) {
+                ss->degrade--;
+                st->good_slots = 0;
+            }
+        } else {
+            ss->dropped_slots++;
+            st->good_slots = 0;
+            if(def->degradable && ss->degrade < TELEMETRY_MAX_DEGRADE)
+                ss->degrade++;
+        }
+
+        // next slot on the grid, resync if we fell more than a slot behind
+        st->next_due += interval;
+        if(time_reached(now, st->next_due + interval))
+            st->next_due = now + interval;
+    }
+}
+
+/*
+ * Start sending the whole parameter list on the PARAMS stream. Only posts
+ * the request, the telemetry thread restarts the list on its next slot.
+ */
+void telemetry_request_param_list(void) {
+    param_list_request = true;
+}
+
+static uint8_t mav_param_type(ap_var_type type) {
+    switch(type) {
+    case AP_PARAM_INT8:
+        return MAV_PARAM_TYPE_INT8;
+    case AP_PARAM_INT16:
+        return MAV_PARAM_TYPE_INT16;
+    case AP_PARAM_INT32:
+        return MAV_PARAM_TYPE_INT32;
+    case AP_PARAM_FLOAT:
+    default:
+        return MAV_PARAM_TYPE_REAL32;
+    }
+}
+
+static bool queue_param(mavlink_channel_t chan, const char *name, float value,
+        uint8_t type, uint16_t index) {
+    telem_msg_t *msg;
+
+    if(chan != MAVLINK_COMM_ALL && !mavlink_link_active(chan))
+        return false;
+    msg = pool_allocX(&msg_pool);
+    if(msg == NULL) {
+        atomic_inc(&stats.queue_dropped[chan]);
+        return false;
+    }
+    // param_id is not terminated when the name fills it
+    memset(msg->name, 0, sizeof(msg->name));
+    memcpy(msg->name, name, strnlen(name, sizeof(msg->name)));
+    msg->value = value;
+    msg->type = type;
+    msg->index = index;
+    if(!queue_push(chan, msg)) {
+        pool_freeX(&msg_pool, msg);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Queue PARAM_VALUE for one parameter on a link, index is its position in
+ * the list. Never blocks, returns false if the queue is full.
+ */
+bool telemetry_queue_param(mavlink_channel_t chan, const Info *info, uint16_t index) {
+    return queue_param(chan, info->name, cast_to_float((ap_var_type)info->type, info->ptr),
+            mav_param_type((ap_var_type)info->type), index);
+}
+
+// Report a parameter change on all links, called from save_parameter()
+void send_parameter_value_all(const char *name, ap_var_type type, float value) {
+    // index unknown, the GCS matches by name
+    queue_param(MAVLINK_COMM_ALL, name, value, mav_param_type(type), 0xFFFF);
+}
+
+static uint16_t send_params(const mavlink_links_t *links) {
+    if(param_list_request) {
+        param_list_request = false;
+        param_next = first_param(&param_token, NULL);
+        param_index = 0;
+        param_list_active = param_next != NULL;
+    }
+    if(!param_list_active)
+        return 0;
+
+    float value = cast_to_float((ap_var_type)param_next->type, param_next->ptr);
+    for(uint8_t i = 0; i < links->n; i++) {
+        mavlink_lock(links->chan[i]);
+        mavlink_msg_param_value_send(links->chan[i], param_next->name, value,
+                mav_param_type((ap_var_type)param_next->type),
+                count_parameters(), param_index);
+        mavlink_unlock(links->chan[i]);
+    }
+    param_index++;
+    param_next = next_scalar(&param_token, NULL);
+    if(param_next == NULL)
+        param_list_active = false;
+    return MSG_SIZE(MAVLINK_MSG_ID_PARAM_VALUE_LEN);
+}
+
+/*
+ * The subscription belongs to the telemetry thread, so it is made on the
+ * first call. Without a new frame the last one is sent again.
+ */
+static uint16_t send_rc_channels(const mavlink_links_t *links) {
+    uint16_t ch[8];
+
+    if(!rc_subscribed) {
+        topic_subscribe(&rc_sub, &rc_frame_topic, &rc_frame, TELEMETRY_EVT_RC);
+        rc_subscribed = true;
+    }
+    (void) topic_read(&rc_sub);
+    memset(ch, 0, sizeof(ch));
+    for(uint8_t i = 0; i < 8 && i < rc_frame.num_channels; i++)
+        ch[i] = rc_frame.channels[i];
+    uint32_t t = millis();
+    for(uint8_t i = 0; i < links->n; i++) {
+        mavlink_lock(links->chan[i]);
+        mavlink_msg_rc_channels_raw_send(links->chan[i], t, 0,
+                ch[0], ch[1], ch[2], ch[3], ch[4], ch[5], ch[6], ch[7], 255);
+        mavlink_unlock(links->chan[i]);
+    }
+    return MSG_SIZE(MAVLINK_MSG_ID_RC_CHANNELS_RAW_LEN);
+}
+
+// SR_TRACE carries the kernel trace and the RC edge trace dumps, kernel first
+static uint16_t send_trace(const mavlink_links_t *links) {
+    uint16_t bytes = kernel_trace_send(links);
+    if(bytes == 0)
+        bytes = rc_trace_send(links);
+    return bytes;
+}
+
+const telemetry_stats_t *telemetry_get_stats(void) {
+    return &stats;
+}
+
+// Share of the link bandwidth used, percent
+uint8_t telemetry_link_load(void) {
+    if(stats.budget_bytes == 0)
+        return 0;
+    return (uint8_t)(((uint64_t)stats.used_bytes * 100) / stats.budget_bytes);
+}
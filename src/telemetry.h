@@ -0,0 +1,64 @@
+#ifndef SRC_TELEMETRY_H_
+#define SRC_TELEMETRY_H_
+
+#include "ch.h"
+#include "hal.h"
+
+#include "mavlink_bridge.h"
+#include "parameters.h"
+
+// Telemetry streams in priority order, rates are the SR_* parameters
+enum streams {
+    STREAM_PARAMS = 0,
+    STREAM_RAW_SENSORS,
+    STREAM_RC_CHANNELS,
+    STREAM_RAW_CONTROLLER,
+    STREAM_SYSTEM,
+    STREAM_TRACE,
+    NUM_STREAMS
+};
+
+// Scheduler tick, the UART byte budget is handed out per tick
+#define TELEMETRY_TICK_HZ       100
+// Unused budget carried over to the next tick, in ticks
+#define TELEMETRY_BUDGET_CARRY  2
+// Queued messages per link, power of two
+#ifndef TELEMETRY_QUEUE_LEN
+#define TELEMETRY_QUEUE_LEN     8
+#endif
+// Queued messages of all links together
+#ifndef TELEMETRY_MSG_POOL_SIZE
+#define TELEMETRY_MSG_POOL_SIZE 16
+#endif
+// Max slowdown of a saturated stream, rate / 2^n
+#define TELEMETRY_MAX_DEGRADE   4
+// Slots sent in a row before a degraded stream speeds up again
+#define TELEMETRY_RECOVER_SLOTS 20
+
+typedef struct {
+    uint32_t sent;              // messages
+    uint32_t bytes;
+    uint32_t dropped_slots;     // due but no budget left
+    uint8_t degrade;            // current slowdown, rate / 2^degrade
+} stream_stats_t;
+
+typedef struct {
+    uint32_t ticks;
+    uint32_t budget_bytes;      // bytes offered by the link
+    uint32_t used_bytes;        // bytes sent
+    uint32_t forwarded_bytes;   // of those, forwarded by the router
+    uint32_t queued_sent;       // queued messages sent
+    volatile uint32_t queue_dropped[MAVLINK_COMM_NUM_BUFFERS];  // queue or pool full
+    stream_stats_t streams[NUM_STREAMS];
+} telemetry_stats_t;
+
+void init_telemetry(void);
+void telemetry_update(void);
+void telemetry_request_param_list(void);
+bool telemetry_queue_param(mavlink_channel_t chan, const Info *info, uint16_t index);
+void send_parameter_value_all(const char *name, ap_var_type type, float value);
+void telemetry_account_bytes(uint16_t bytes);
+const telemetry_stats_t *telemetry_get_stats(void);
+uint8_t telemetry_link_load(void);
+
+#endif /* SRC_TELEMETRY_H_ */
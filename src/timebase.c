@@ -0,0 +1,45 @@
+#include "ch.h"
+#include "hal.h"
+
+#include "timebase.h"
+
+// Well within the 71.6 minute wrap of the system time
+#define EXTEND_PERIOD   S2ST(600)
+
+static uint64_t time_total = 0;
+static systime_t time_last = 0;
+static virtual_timer_t extend_vt;
+
+static void extend_cb(void *arg) {
+    (void) arg;
+    chSysLockFromISR();
+    (void) micros64();
+    chVTSetI(&extend_vt, EXTEND_PERIOD, extend_cb, NULL);
+    chSysUnlockFromISR();
+}
+
+void init_timebase(void) {
+    time_last = chVTGetSystemTimeX();
+    chVTObjectInit(&extend_vt);
+    chVTSet(&extend_vt, EXTEND_PERIOD, extend_cb, NULL);
+}
+
+// Microseconds since init_timebase(), usable from threads and ISRs
+uint64_t micros64(void) {
+    syssts_t sts = chSysGetStatusAndLockX();
+    systime_t now = chVTGetSystemTimeX();
+    time_total += (systime_t)(now - time_last);
+    time_last = now;
+    uint64_t t = time_total;
+    chSysRestoreStatusX(sts);
+    return t;
+}
+
+// System time, wraps every 71.6 minutes
+uint32_t micros(void) {
+    return chVTGetSystemTimeX();
+}
+
+uint32_t millis(void) {
+    return (uint32_t)(micros64() / 1000);
+}
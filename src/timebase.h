@@ -0,0 +1,27 @@
+#ifndef SRC_TIMEBASE_H_
+#define SRC_TIMEBASE_H_
+
+#include "ch.h"
+#include "hal.h"
+
+/*
+ * Microsecond time. The kernel runs tickless at 1 MHz on TIM2, extended
+ * from 16 to 32 bit in software (drivers/st/st_lld.c), so system time is
+ * in microseconds and wakeups are exact to the microsecond. It wraps every
+ * 71.6 minutes: timeouts and periods must stay below half that.
+ *
+ * micros64() extends it to 64 bit for timestamps across the uptime.
+ */
+#if CH_CFG_ST_FREQUENCY != 1000000
+#error "the timebase expects a 1 MHz system time"
+#endif
+
+// US2ST() and MS2ST() overflow above 4.3 ms and 4.3 s at 1 MHz, rounds up like them
+#define TIMEBASE_US2ST(us)  ((systime_t)(((uint64_t)(us) * CH_CFG_ST_FREQUENCY + 999999) / 1000000))
+
+void init_timebase(void);
+uint64_t micros64(void);
+uint32_t micros(void);
+uint32_t millis(void);
+
+#endif /* SRC_TIMEBASE_H_ */
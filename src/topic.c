@@ -0,0 +1,95 @@
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "topic.h"
+
+/*
+ * Store a new value and wake the subscribers. Called from ISRs or with
+ * the kernel lock held.
+ */
+void topic_publishI(topic_t *topic, const void *data) {
+    seqlock_write_begin(&topic->lock);
+    memcpy(topic->data, data, topic->size);
+    topic->seq++;
+    seqlock_write_end(&topic->lock);
+    chEvtBroadcastFlagsI(&topic->es, TOPIC_FLAG_NEW);
+}
+
+void topic_publish(topic_t *topic, const void *data) {
+    chSysLock();
+    topic_publishI(topic, data);
+    chSchRescheduleS();
+    chSysUnlock();
+}
+
+/*
+ * Register the calling thread on a topic. New values raise
+ * EVENT_MASK(eid) on the thread, buf receives the copies and must hold
+ * one value of the topic.
+ */
+void topic_subscribe(topic_sub_t *sub, topic_t *topic, void *buf, eventid_t eid) {
+    sub->topic = topic;
+    sub->buf = buf;
+    sub->eid = eid;
+    sub->missed = 0;
+    chSysLock();
+    // only values published from now on are new
+    sub->last_seq = topic->seq;
+    chSysUnlock();
+    chEvtRegisterMaskWithFlags(&topic->es, &sub->el, EVENT_MASK(eid), TOPIC_FLAG_NEW);
+}
+
+void topic_unsubscribe(topic_sub_t *sub) {
+    chEvtUnregister(&sub->topic->es, &sub->el);
+}
+
+/*
+ * Copy the latest value into the subscriber buffer. Returns false if
+ * nothing was published since the last read, the buffer is unchanged
+ * then.
+ */
+bool topic_read(topic_sub_t *sub) {
+    topic_t *topic = sub->topic;
+    uint32_t seq, value_seq;
+
+    do {
+        seq = seqlock_read_begin(&topic->lock);
+        value_seq = topic->seq;
+        if(value_seq != sub->last_seq)
+            memcpy(sub->buf, topic->data, topic->size);
+    } while(seqlock_read_retry(&topic->lock, seq));
+
+    if(value_seq == sub->last_seq)
+        return false;
+    sub->missed += value_seq - sub->last_seq - 1;
+    sub->last_seq = value_seq;
+    return true;
+}
+
+/*
+ * Block until a value newer than the last read one is published, then
+ * copy it. Returns false on timeout, counted from the call however often
+ * the thread is woken for values it already has. Other events of the
+ * thread are left pending.
+ */
+bool topic_wait(topic_sub_t *sub, systime_t timeout) {
+    eventmask_t mask = EVENT_MASK(sub->eid);
+    systime_t start = chVTGetSystemTimeX();
+    systime_t left = timeout;
+
+    // drop a pending event for a value that was already read
+    chEvtGetAndClearEvents(mask);
+    if(topic_read(sub))
+        return true;
+    while(left != TIME_IMMEDIATE && chEvtWaitAnyTimeout(mask, left) != 0) {
+        if(topic_read(sub))
+            return true;
+        if(timeout != TIME_INFINITE) {
+            systime_t elapsed = chVTGetSystemTimeX() - start;
+            left = elapsed < timeout ? timeout - elapsed : TIME_IMMEDIATE;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,55 @@
+#ifndef SRC_TOPIC_H_
+#define SRC_TOPIC_H_
+
+#include "ch.h"
+#include "hal.h"
+
+#include "seqlock.h"
+
+/*
+ * Publish/subscribe on top of event sources. A topic holds the latest
+ * value of its type, producers overwrite it from ISRs or threads and
+ * broadcast TOPIC_FLAG_NEW to the registered listeners. Every subscriber
+ * has its own buffer the latest value is copied into when it reads, so
+ * a slow consumer only ever sees the newest value and counts the ones it
+ * missed.
+ *
+ * Publishing is serialized by the kernel lock, reading is lock-free.
+ */
+#define TOPIC_FLAG_NEW      ((eventflags_t)1)
+
+typedef struct {
+    const char *name;
+    event_source_t es;
+    seqlock_t lock;
+    void *data;
+    size_t size;
+    uint32_t seq;               // number of published values
+} topic_t;
+
+typedef struct {
+    event_listener_t el;
+    topic_t *topic;
+    void *buf;                  // subscriber copy, topic size
+    eventid_t eid;
+    uint32_t last_seq;
+    uint32_t missed;            // values overwritten before they were read
+} topic_sub_t;
+
+// Statically allocated topic with storage for one value of type
+#define TOPIC_DEF(var, name, type)                                      \
+    static type var##_data;                                             \
+    topic_t var = {                                                     \
+        (name), _EVENTSOURCE_DATA(var.es), SEQLOCK_INIT,                \
+        &var##_data, sizeof(type), 0                                    \
+    }
+
+void topic_publishI(topic_t *topic, const void *data);
+void topic_publish(topic_t *topic, const void *data);
+
+void topic_subscribe(topic_sub_t *sub, topic_t *topic, void *buf, eventid_t eid);
+void topic_unsubscribe(topic_sub_t *sub);
+bool topic_read(topic_sub_t *sub);
+bool topic_wait(topic_sub_t *sub, systime_t timeout);
+
+#endif /* SRC_TOPIC_H_ */
@@ -0,0 +1,147 @@
+#include <string.h>
+#include <math.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "mavlink_bridge.h"
+#include "mavlink.h"
+
+#include "tune_log.h"
+#include "parameters_d.h"
+
+#if (TUNE_LOG_RING_SIZE & (TUNE_LOG_RING_SIZE - 1)) != 0
+#error "TUNE_LOG_RING_SIZE must be a power of two"
+#endif
+
+#define MAX_VARINT_SIZE         5
+
+typedef struct {
+    uint32_t index;             // capture count when taken
+    int32_t v[TUNE_LOG_NUM_SIGNALS];
+} tune_sample_t;
+
+// single producer (control loop), single consumer (telemetry thread)
+static tune_sample_t ring[TUNE_LOG_RING_SIZE];
+static volatile uint32_t head = 0;     // samples written
+static volatile uint32_t tail = 0;     // samples sent
+static uint32_t captures = 0;           // samples taken, dropped ones included
+static uint32_t next_index = 0;         // capture after the last one sent
+static uint8_t controller = 0;
+static uint16_t period = 0;
+
+static uint8_t seq = 0;
+static tune_log_stats_t stats;
+
+static inline int32_t to_fixed(float x) {
+    float s = x * TUNE_LOG_SCALE;
+    if(s > INT32_MAX / 2)
+        return INT32_MAX / 2;
+    if(s < INT32_MIN / 2)
+        return INT32_MIN / 2;
+    return (int32_t)lrintf(s);
+}
+
+/*
+ * Called by a controller every loop, samples of controllers not selected
+ * by PID_REPORT are ignored. Never blocks, a full ring drops the sample.
+ */
+void tune_log_capture(uint8_t ctrl, uint16_t period_us,
+        float setpoint, float measurement, float p, float i, float d, float output) {
+    if(ctrl != pid_report || stream_rates[STREAM_RAW_CONTROLLER] <= 0)
+        return;
+
+    uint32_t h = head;
+    uint32_t index = captures++;
+    if(h - tail >= TUNE_LOG_RING_SIZE) {
+        stats.overruns++;
+        return;
+    }
+    tune_sample_t *s = &ring[h % TUNE_LOG_RING_SIZE];
+    s->index = index;
+    s->v[TUNE_SETPOINT] = to_fixed(setpoint);
+    s->v[TUNE_MEASUREMENT] = to_fixed(measurement);
+    s->v[TUNE_P] = to_fixed(p);
+    s->v[TUNE_I] = to_fixed(i);
+    s->v[TUNE_D] = to_fixed(d);
+    s->v[TUNE_OUTPUT] = to_fixed(output);
+    controller = ctrl;
+    period = period_us;
+    __DMB();
+    head = h + 1;
+    stats.samples++;
+}
+
+static uint8_t put_varint(uint8_t *buf, int32_t value) {
+    uint32_t zz = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    uint8_t n = 0;
+    while(zz >= 0x80) {
+        buf[n++] = (uint8_t)(zz | 0x80);
+        zz >>= 7;
+    }
+    buf[n++] = (uint8_t)zz;
+    return n;
+}
+
+/*
+ * Pack as many queued samples as fit into one DATA96 and send it. A frame
+ * holds consecutive captures only, it ends at a dropped sample.
+ * Returns bytes sent, 0 if there was nothing to send.
+ */
+uint16_t tune_log_send(const mavlink_links_t *links) {
+    uint8_t data[TUNE_LOG_FRAME_SIZE];
+    uint8_t pos = TUNE_LOG_HEADER_SIZE;
+    uint8_t count = 0;
+    uint32_t t = tail;
+    uint32_t first;
+    uint32_t dropped;
+    const tune_sample_t *prev = NULL;
+
+    if(head == t)
+        return 0;
+    __DMB();
+
+    first = ring[t % TUNE_LOG_RING_SIZE].index;
+    dropped = first - next_index;
+    while(t != head && pos + TUNE_LOG_NUM_SIGNALS * MAX_VARINT_SIZE <= TUNE_LOG_FRAME_SIZE && count < 255) {
+        const tune_sample_t *s = &ring[t % TUNE_LOG_RING_SIZE];
+        if(s->index != first + count)
+            break;
+        for(uint8_t i = 0; i < TUNE_LOG_NUM_SIGNALS; i++) {
+            int32_t v = prev != NULL ? s->v[i] - prev->v[i] : s->v[i];
+            pos += put_varint(&data[pos], v);
+        }
+        prev = s;
+        count++;
+        t++;
+    }
+
+    data[0] = seq++;
+    data[1] = controller;
+    data[2] = count;
+    data[3] = dropped > 255 ? 255 : dropped;
+    data[4] = period & 0xFF;
+    data[5] = period >> 8;
+    data[6] = first & 0xFF;
+    data[7] = (first >> 8) & 0xFF;
+    data[8] = (first >> 16) & 0xFF;
+    data[9] = first >> 24;
+
+    // samples are read before the cells are handed back
+    __DMB();
+    tail = t;
+    next_index = first + count;
+
+    for(uint8_t i = 0; i < links->n; i++) {
+        mavlink_lock(links->chan[i]);
+        mavlink_msg_data96_send(links->chan[i], TUNE_LOG_DATA_TYPE, pos, data);
+        mavlink_unlock(links->chan[i]);
+    }
+    stats.frames++;
+    stats.bytes += pos;
+    return MAVLINK_MSG_ID_DATA96_LEN + MAVLINK_NUM_NON_PAYLOAD_BYTES;
+}
+
+const tune_log_stats_t *tune_log_get_stats(void) {
+    return &stats;
+}
@@ -0,0 +1,66 @@
+#ifndef SRC_TUNE_LOG_H_
+#define SRC_TUNE_LOG_H_
+
+#include "ch.h"
+#include "hal.h"
+
+#include "mavlink_bridge.h"
+
+/*
+ * Loop rate capture of one PID controller for tuning. The controller
+ * selected by PID_REPORT pushes a sample every loop, the telemetry thread
+ * packs them into DATA96 messages on the SR_PID_CONT stream.
+ *
+ * DATA96 payload, type TUNE_LOG_DATA_TYPE:
+ *   u8 seq, u8 controller, u8 samples, u8 dropped before this frame (max 255),
+ *   u16 period_us, u32 capture index of the first sample,
+ *   then for each sample TUNE_LOG_NUM_SIGNALS zigzag varints. The capture
+ *   index counts dropped samples too, so a jump between frames is a gap
+ *   in the series. Samples of a frame are consecutive captures. The first
+ *   sample is absolute, the others are deltas to the previous sample, so
+ *   each frame decodes on its own. Values are fixed point, 1/TUNE_LOG_SCALE.
+ * A frame holds 2 samples in the worst case and around 6 for slowly moving
+ * signals. To get every sample SR_PID_CONT must be at least the loop rate
+ * divided by the samples per frame, otherwise the ring overruns and the
+ * series has gaps.
+ * tools/tune_log_decode.py rebuilds the time series from a tlog.
+ */
+#define TUNE_LOG_DATA_TYPE      0x54
+#define TUNE_LOG_SCALE          1000
+#define TUNE_LOG_HEADER_SIZE    10
+#define TUNE_LOG_FRAME_SIZE     96      // DATA96 payload
+
+#ifndef TUNE_LOG_RING_SIZE
+#define TUNE_LOG_RING_SIZE      32      // samples, power of two
+#endif
+
+// values of PID_REPORT
+enum tune_log_controllers {
+    TUNE_LOG_VOLT = 0,
+    TUNE_LOG_RPM = 1,
+    TUNE_LOG_DRIVE = 2          // open loop drive, setpoint angle, output phase A duty
+};
+
+enum tune_log_signals {
+    TUNE_SETPOINT = 0,
+    TUNE_MEASUREMENT,
+    TUNE_P,
+    TUNE_I,
+    TUNE_D,
+    TUNE_OUTPUT,
+    TUNE_LOG_NUM_SIGNALS
+};
+
+typedef struct {
+    uint32_t samples;           // captured
+    uint32_t overruns;          // ring full, sample lost
+    uint32_t frames;
+    uint32_t bytes;             // encoded payload bytes
+} tune_log_stats_t;
+
+void tune_log_capture(uint8_t controller, uint16_t period_us,
+        float setpoint, float measurement, float p, float i, float d, float output);
+uint16_t tune_log_send(const mavlink_links_t *links);
+const tune_log_stats_t *tune_log_get_stats(void);
+
+#endif /* SRC_TUNE_LOG_H_ */
@@ -0,0 +1,83 @@
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "storage.h"
+#include "led.h"
+#include "rc_input.h"
+#include "monitor.h"
+#include "kernel_trace.h"
+#include "rc_trace.h"
+#include "tasks.h"
+#include "timebase.h"
+
+/*
+ * Firmware services the telemetry path calls, replaced for the host
+ * benchmark. Parameters live in a RAM storage, RC frames are published
+ * by the benchmark and the kernel monitor and trace streams have nothing
+ * to send.
+ */
+
+#define BENCH_STORAGE_SIZE      1024
+
+static uint8_t storage[BENCH_STORAGE_SIZE];
+
+bool init_storage(void) {
+    memset(storage, 0xFF, sizeof(storage));
+    return true;
+}
+
+bool storage_read(const void *data, uint16_t addr, size_t n) {
+    if(addr + n > sizeof(storage))
+        return false;
+    memcpy((void *)data, &storage[addr], n);
+    return true;
+}
+
+bool storage_write(uint16_t addr, const void *data, size_t n) {
+    if(addr + n > sizeof(storage))
+        return false;
+    memcpy(&storage[addr], data, n);
+    return true;
+}
+
+bool storage_flush(void) {
+    return true;
+}
+
+uint16_t storage_size(void) {
+    return sizeof(storage);
+}
+
+void led_set_state(uint8_t state, bool on) {
+    (void) state;
+    (void) on;
+}
+
+TOPIC_DEF(rc_frame_topic, "rc_frame", rc_frame_t);
+
+uint16_t monitor_send(const mavlink_links_t *links) {
+    (void) links;
+    return 0;
+}
+
+uint16_t kernel_trace_send(const mavlink_links_t *links) {
+    (void) links;
+    return 0;
+}
+
+uint16_t rc_trace_send(const mavlink_links_t *links) {
+    (void) links;
+    return 0;
+}
+
+// The benchmark calls telemetry_update() itself
+bool tasks_add(const task_t *task) {
+    (void) task;
+    return true;
+}
+
+uint32_t millis(void) {
+    return (uint32_t)(host_time_ns() / 1000000);
+}
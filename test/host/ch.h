@@ -0,0 +1,170 @@
+/*
+ * Host stand-in for the subset of the ChibiOS 16 RT API used by the
+ * MAVLink path, for the loopback benchmark. Single threaded, the system
+ * time is a simulated 1 MHz clock advanced by the benchmark, the realtime
+ * counter runs on the host clock so time measurements show host CPU time.
+ */
+#ifndef TEST_HOST_CH_H_
+#define TEST_HOST_CH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef TRUE
+#define TRUE                    1
+#endif
+#ifndef FALSE
+#define FALSE                   0
+#endif
+
+#define CH_CFG_ST_RESOLUTION    32
+#define CH_CFG_ST_FREQUENCY     1000000
+#define CH_CFG_ST_TIMEDELTA     0
+#define CH_CFG_USE_MUTEXES      TRUE
+#define CH_DBG_ENABLE_TRACE     FALSE
+#define CH_DBG_ENABLE_ASSERTS   TRUE
+#define CH_DBG_STATISTICS       FALSE
+#define CH_DBG_FILL_THREADS     FALSE
+
+typedef uint32_t systime_t;
+typedef uint32_t rtcnt_t;
+typedef uint64_t rttime_t;
+typedef int32_t msg_t;
+typedef uint32_t eventmask_t;
+typedef uint32_t eventflags_t;
+typedef int32_t eventid_t;
+typedef uint32_t syssts_t;
+typedef uint32_t tprio_t;
+typedef uint8_t tstate_t;
+typedef uint32_t ucnt_t;
+typedef uint64_t stkalign_t;
+
+#define MSG_OK                  0
+#define MSG_TIMEOUT             -1
+#define TIME_IMMEDIATE          ((systime_t)0)
+#define TIME_INFINITE           ((systime_t)-1)
+#define ALL_EVENTS              ((eventmask_t)-1)
+#define EVENT_MASK(eid)         ((eventmask_t)1 << (eventmask_t)(eid))
+#define NORMALPRIO              128
+
+#define S2ST(sec)               ((systime_t)((uint64_t)(sec) * CH_CFG_ST_FREQUENCY))
+#define MS2ST(msec)             ((systime_t)(((uint64_t)(msec) * CH_CFG_ST_FREQUENCY + 999) / 1000))
+#define US2ST(usec)             ((systime_t)(((uint64_t)(usec) * CH_CFG_ST_FREQUENCY + 999999) / 1000000))
+#define ST2US(n)                ((uint32_t)(((uint64_t)(n) * 1000000 + CH_CFG_ST_FREQUENCY - 1) / CH_CFG_ST_FREQUENCY))
+#define ST2MS(n)                ((uint32_t)(((uint64_t)(n) * 1000 + CH_CFG_ST_FREQUENCY - 1) / CH_CFG_ST_FREQUENCY))
+#define RTC2US(freq, n)         ((uint32_t)((uint64_t)(n) * 1000000 / (freq)))
+
+typedef struct {
+    rtcnt_t best;
+    rtcnt_t worst;
+    rtcnt_t last;
+    ucnt_t n;
+    rttime_t cumulative;
+} time_measurement_t;
+
+typedef struct {
+    const char *p_name;
+} thread_t;
+
+typedef struct {
+    thread_t *m_owner;
+} mutex_t;
+
+typedef struct event_listener {
+    struct event_listener *el_next;
+} event_listener_t;
+
+typedef struct {
+    event_listener_t *es_next;
+} event_source_t;
+
+typedef void *(*memgetfunc_t)(size_t size);
+
+typedef struct {
+    void *mp_next;
+    size_t mp_object_size;
+    memgetfunc_t mp_provider;
+} memory_pool_t;
+
+#define _MUTEX_DATA(name)                   { NULL }
+#define MUTEX_DECL(name)                    mutex_t name = _MUTEX_DATA(name)
+#define _EVENTSOURCE_DATA(name)             { NULL }
+#define _MEMORYPOOL_DATA(name, size, provider) { NULL, size, provider }
+
+#define THD_WORKING_AREA(s, n)  stkalign_t s[((n) + sizeof(stkalign_t) - 1) / sizeof(stkalign_t)]
+
+void chSysHalt(const char *reason);
+#define chDbgAssert(c, r)       do { if(!(c)) chSysHalt(r); } while(false)
+#define chDbgCheck(c)           chDbgAssert(c, "check")
+#define chDbgCheckClassI()
+#define chDbgCheckClassS()
+
+// One thread, no interrupts, locking is a no-op
+static inline void chSysLock(void) {}
+static inline void chSysUnlock(void) {}
+static inline void chSysLockFromISR(void) {}
+static inline void chSysUnlockFromISR(void) {}
+static inline syssts_t chSysGetStatusAndLockX(void) { return 0; }
+static inline void chSysRestoreStatusX(syssts_t sts) { (void) sts; }
+
+rtcnt_t chSysGetRealtimeCounterX(void);
+systime_t chVTGetSystemTimeX(void);
+#define chVTGetSystemTime()     chVTGetSystemTimeX()
+thread_t *chThdGetSelfX(void);
+
+// There are no receive threads on the host, signals are dropped
+static inline void chEvtSignalI(thread_t *tp, eventmask_t events) {
+    (void) tp;
+    (void) events;
+}
+
+// Listeners are not chained, broadcasts and waits have nothing to wake
+static inline void chEvtBroadcastFlagsI(event_source_t *esp, eventflags_t flags) {
+    (void) esp;
+    (void) flags;
+}
+
+static inline void chEvtRegisterMaskWithFlags(event_source_t *esp, event_listener_t *elp,
+        eventmask_t events, eventflags_t wflags) {
+    (void) esp;
+    (void) elp;
+    (void) events;
+    (void) wflags;
+}
+
+static inline void chEvtUnregister(event_source_t *esp, event_listener_t *elp) {
+    (void) esp;
+    (void) elp;
+}
+
+static inline eventmask_t chEvtGetAndClearEvents(eventmask_t events) {
+    (void) events;
+    return 0;
+}
+
+static inline eventmask_t chEvtWaitAnyTimeout(eventmask_t events, systime_t time) {
+    (void) events;
+    (void) time;
+    return 0;
+}
+
+static inline void chSchRescheduleS(void) {}
+
+void chMtxObjectInit(mutex_t *mp);
+void chMtxLock(mutex_t *mp);
+void chMtxUnlock(mutex_t *mp);
+
+void chTMObjectInit(time_measurement_t *tmp);
+void chTMStartMeasurementX(time_measurement_t *tmp);
+void chTMStopMeasurementX(time_measurement_t *tmp);
+
+void chPoolLoadArray(memory_pool_t *mp, void *p, size_t n);
+void *chPoolAllocI(memory_pool_t *mp);
+void chPoolFreeI(memory_pool_t *mp, void *objp);
+
+// Simulated time, ns since start
+uint64_t host_time_ns(void);
+void host_set_time_ns(uint64_t ns);
+
+#endif /* TEST_HOST_CH_H_ */
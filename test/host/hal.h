@@ -0,0 +1,42 @@
+/*
+ * Host stand-in for the subset of the ChibiOS HAL and CMSIS used by the
+ * MAVLink path, see ch.h.
+ */
+#ifndef TEST_HOST_HAL_H_
+#define TEST_HOST_HAL_H_
+
+#include "ch.h"
+
+#define HAL_USE_SERIAL_USB      FALSE
+#define STM32_HCLK              72000000
+
+#define STM32_SERIAL_USE_USART1 FALSE
+#define STM32_SERIAL_USE_USART2 FALSE
+#define STM32_SERIAL_USE_USART3 FALSE
+#define STM32_UART_USE_USART1   FALSE
+#define STM32_UART_USE_USART2   FALSE
+#define STM32_UART_USE_USART3   FALSE
+#define STM32_I2C_USE_I2C1      TRUE
+
+typedef struct {
+    volatile uint32_t SR, DR, BRR, CR1, CR2, CR3, GTPR;
+} USART_TypeDef;
+
+typedef struct {
+    uint8_t index;
+} stm32_dma_stream_t;
+
+// Pins have no meaning on the host
+#define GPIOA                   NULL
+#define GPIOC                   NULL
+#define PAL_MODE_INPUT          0
+#define PAL_MODE_STM32_ALTERNATE_PUSHPULL 1
+#define palSetPadMode(port, pad, mode)  ((void)(port), (void)(pad), (void)(mode))
+
+// Single threaded, exclusive access always succeeds
+static inline uint32_t __LDREXW(volatile uint32_t *addr) { return *addr; }
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t *addr) { *addr = value; return 0; }
+static inline void __CLREX(void) {}
+static inline void __DMB(void) { __sync_synchronize(); }
+
+#endif /* TEST_HOST_HAL_H_ */
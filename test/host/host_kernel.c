@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ch.h"
+#include "hal.h"
+
+static uint64_t sim_ns = 0;
+static thread_t main_thread = { "main" };
+
+uint64_t host_time_ns(void) {
+    return sim_ns;
+}
+
+void host_set_time_ns(uint64_t ns) {
+    sim_ns = ns;
+}
+
+void chSysHalt(const char *reason) {
+    fprintf(stderr, "halt: %s\n", reason);
+    abort();
+}
+
+systime_t chVTGetSystemTimeX(void) {
+    return (systime_t)(sim_ns / 1000);
+}
+
+// Host CPU time in HCLK cycles, for time measurements
+rtcnt_t chSysGetRealtimeCounterX(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ns = (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+    return (rtcnt_t)(ns * (STM32_HCLK / 1000000) / 1000);
+}
+
+thread_t *chThdGetSelfX(void) {
+    return &main_thread;
+}
+
+void chMtxObjectInit(mutex_t *mp) {
+    mp->m_owner = NULL;
+}
+
+void chMtxLock(mutex_t *mp) {
+    chDbgAssert(mp->m_owner == NULL, "mutex already locked");
+    mp->m_owner = chThdGetSelfX();
+}
+
+void chMtxUnlock(mutex_t *mp) {
+    chDbgAssert(mp->m_owner == chThdGetSelfX(), "mutex not owned");
+    mp->m_owner = NULL;
+}
+
+void chTMObjectInit(time_measurement_t *tmp) {
+    tmp->best = (rtcnt_t)-1;
+    tmp->worst = 0;
+    tmp->last = 0;
+    tmp->n = 0;
+    tmp->cumulative = 0;
+}
+
+void chTMStartMeasurementX(time_measurement_t *tmp) {
+    tmp->last = chSysGetRealtimeCounterX();
+}
+
+void chTMStopMeasurementX(time_measurement_t *tmp) {
+    tmp->last = chSysGetRealtimeCounterX() - tmp->last;
+    tmp->n++;
+    tmp->cumulative += tmp->last;
+    if(tmp->last > tmp->worst)
+        tmp->worst = tmp->last;
+    if(tmp->last < tmp->best)
+        tmp->best = tmp->last;
+}
+
+void chPoolLoadArray(memory_pool_t *mp, void *p, size_t n) {
+    while(n-- > 0) {
+        chPoolFreeI(mp, p);
+        p = (uint8_t *)p + mp->mp_object_size;
+    }
+}
+
+void *chPoolAllocI(memory_pool_t *mp) {
+    void *objp = mp->mp_next;
+    if(objp != NULL)
+        mp->mp_next = *(void **)objp;
+    return objp;
+}
+
+void chPoolFreeI(memory_pool_t *mp, void *objp) {
+    *(void **)objp = mp->mp_next;
+    mp->mp_next = objp;
+}
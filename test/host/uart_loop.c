@@ -0,0 +1,178 @@
+#include <string.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "uart_loop.h"
+
+#define TX_ABORTED              0xFFFF
+#define NO_EVENT                UINT64_MAX
+
+uart_dma_t UDD1;
+uart_dma_t UDD3;
+
+typedef struct {
+    uart_dma_t *udp;
+    uint64_t reserve_ns[UART_DMA_TX_MAX_FRAMES];
+    uint64_t commit_ns[UART_DMA_TX_MAX_FRAMES];
+    uint64_t line_free_ns;      // stop bit of the last byte sent
+    uint64_t start_ns;          // first bit of the frame being sent
+    uint16_t sent;              // bytes of that frame already delivered
+} line_t;
+
+static line_t lines[] = { { &UDD1, { 0 }, { 0 }, 0, 0, 0 }, { &UDD3, { 0 }, { 0 }, 0, 0, 0 } };
+#define NUM_LINES               (sizeof(lines) / sizeof(lines[0]))
+
+static const uart_loop_sink_t *sink = NULL;
+
+static line_t *get_line(uart_dma_t *udp) {
+    for(uint8_t i = 0; i < NUM_LINES; i++) {
+        if(lines[i].udp == udp)
+            return &lines[i];
+    }
+    chSysHalt("no loopback line");
+    return NULL;
+}
+
+// End of the stop bit of byte n (from 0) of a frame starting at start_ns
+static uint64_t byte_done_ns(const uart_dma_t *udp, uint64_t start_ns, uint16_t n) {
+    return start_ns + ((uint64_t)(n + 1) * 10 * 1000000000u) / udp->config->speed;
+}
+
+void uart_dma_start(uart_dma_t *udp, const uart_dma_config_t *config) {
+    line_t *line = get_line(udp);
+
+    memset(udp, 0, sizeof(*udp));
+    udp->config = config;
+    line->line_free_ns = host_time_ns();
+    line->sent = 0;
+}
+
+uint16_t uart_dma_rx_available(uart_dma_t *udp) {
+    (void) udp;
+    return 0;
+}
+
+int16_t uart_dma_getc(uart_dma_t *udp) {
+    (void) udp;
+    return -1;
+}
+
+uint8_t *uart_dma_tx_reserve(uart_dma_t *udp) {
+    line_t *line = get_line(udp);
+    uint8_t *frame = NULL;
+
+    if(udp->tx_count < udp->config->tx_num_frames)
+        frame = pool_allocI(udp->config->tx_pool);
+    if(frame == NULL) {
+        udp->tx_stats.dropped++;
+        return NULL;
+    }
+    udp->tx_frame[udp->tx_head] = frame;
+    line->reserve_ns[udp->tx_head] = host_time_ns();
+    if(++udp->tx_head >= udp->config->tx_num_frames)
+        udp->tx_head = 0;
+    udp->tx_count++;
+    return frame;
+}
+
+void uart_dma_tx_commit(uart_dma_t *udp, uint8_t *frame, uint16_t len) {
+    uint8_t i = udp->tx_tail;
+
+    while(udp->tx_frame[i] != frame) {
+        if(++i >= udp->config->tx_num_frames)
+            i = 0;
+    }
+    udp->tx_len[i] = len > 0 ? len : TX_ABORTED;
+    get_line(udp)->commit_ns[i] = host_time_ns();
+}
+
+bool uart_dma_write(uart_dma_t *udp, const uint8_t *data, uint16_t len) {
+    uint8_t *frame;
+    if(len > udp->config->tx_pool->size)
+        return false;
+    frame = uart_dma_tx_reserve(udp);
+    if(frame == NULL)
+        return false;
+    memcpy(frame, data, len);
+    uart_dma_tx_commit(udp, frame, len);
+    return true;
+}
+
+static void release_head(uart_dma_t *udp) {
+    pool_freeI(udp->config->tx_pool, udp->tx_frame[udp->tx_tail]);
+    udp->tx_len[udp->tx_tail] = 0;
+    if(++udp->tx_tail >= udp->config->tx_num_frames)
+        udp->tx_tail = 0;
+    udp->tx_count--;
+}
+
+// Time the next byte of the line arrives, NO_EVENT if the line is idle
+static uint64_t line_next_ns(line_t *line) {
+    uart_dma_t *udp = line->udp;
+    uint8_t i = udp->tx_tail;
+
+    if(udp->config == NULL || udp->tx_count == 0 || udp->tx_len[i] == 0)
+        return NO_EVENT;
+    if(line->sent == 0) {
+        line->start_ns = line->commit_ns[i] > line->line_free_ns ?
+                line->commit_ns[i] : line->line_free_ns;
+    }
+    return byte_done_ns(udp, line->start_ns, line->sent);
+}
+
+static void line_run(line_t *line, uint64_t t_ns) {
+    uart_dma_t *udp = line->udp;
+    uint64_t t;
+
+    while((t = line_next_ns(line)) != NO_EVENT) {
+        uint8_t i = udp->tx_tail;
+        uint16_t len = udp->tx_len[i];
+
+        if(len == TX_ABORTED) {
+            release_head(udp);
+            continue;
+        }
+        if(t > t_ns)
+            break;
+
+        if(sink != NULL && sink->byte != NULL)
+            sink->byte(udp, udp->tx_frame[i][line->sent], t);
+        if(++line->sent < len)
+            continue;
+
+        line->sent = 0;
+        line->line_free_ns = t;
+        udp->tx_stats.frames++;
+        udp->tx_stats.bytes += len;
+        if(sink != NULL && sink->frame != NULL)
+            sink->frame(udp, len, t - line->reserve_ns[i]);
+        release_head(udp);
+    }
+}
+
+void uart_loop_set_sink(const uart_loop_sink_t *s) {
+    sink = s;
+}
+
+// Deliver every byte that arrives by t_ns
+void uart_loop_run(uint64_t t_ns) {
+    for(uint8_t i = 0; i < NUM_LINES; i++)
+        line_run(&lines[i], t_ns);
+}
+
+// Arrival of the next byte on any line, UINT64_MAX if all are idle
+uint64_t uart_loop_next_ns(void) {
+    uint64_t next = NO_EVENT;
+    for(uint8_t i = 0; i < NUM_LINES; i++) {
+        uint64_t t = line_next_ns(&lines[i]);
+        if(t < next)
+            next = t;
+    }
+    return next;
+}
+
+void uart_loop_reset_stats(void) {
+    for(uint8_t i = 0; i < NUM_LINES; i++)
+        memset(&lines[i].udp->tx_stats, 0, sizeof(uart_dma_tx_stats_t));
+}
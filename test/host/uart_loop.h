@@ -0,0 +1,24 @@
+#ifndef TEST_HOST_UART_LOOP_H_
+#define TEST_HOST_UART_LOOP_H_
+
+#include "uart_dma.h"
+
+/*
+ * Host implementation of the uart_dma TX ring on a simulated line. A
+ * committed frame goes out after the frames ahead of it, one byte every
+ * 10 bit times at the configured speed, and every byte is handed to the
+ * sink at the simulated time its stop bit ends.
+ */
+typedef struct {
+    // called for every byte with the simulated time it arrives
+    void (*byte)(uart_dma_t *udp, uint8_t c, uint64_t t_ns);
+    // called when the last byte of a frame arrived, reserve to last byte
+    void (*frame)(uart_dma_t *udp, uint16_t len, uint64_t latency_ns);
+} uart_loop_sink_t;
+
+void uart_loop_set_sink(const uart_loop_sink_t *sink);
+void uart_loop_run(uint64_t t_ns);
+uint64_t uart_loop_next_ns(void);
+void uart_loop_reset_stats(void);
+
+#endif /* TEST_HOST_UART_LOOP_H_ */
@@ -0,0 +1,280 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ch.h"
+#include "hal.h"
+
+#include "mavlink_bridge.h"
+#include "mavlink.h"
+
+#include "uart_loop.h"
+#include "telemetry.h"
+#include "parameters.h"
+#include "parameters_d.h"
+#include "tune_log.h"
+#include "rc_input.h"
+#include "mavlink_bench.h"
+
+/*
+ * MAVLink TX path on the host: the firmware bridge, telemetry scheduler,
+ * parameter queue and tuning log send over a simulated UART at
+ * MAVLINK_BAUD and every byte is run through the MAVLink parser on the
+ * other end. Time is simulated, so the results only depend on the code
+ * and the stream mix. Latency is frame reserve, when the message is
+ * serialized, to the last byte parsed. CPU is host time per message spent
+ * between MAVLINK_START_UART_SEND and MAVLINK_END_UART_SEND.
+ *
+ *   mavlink_loop_bench [-t seconds] [mix ...]
+ */
+
+#define NS_PER_MS           1000000ull
+#define MAX_LATENCIES       (1 << 20)
+
+enum { MIX_RAW, MIX_SCHED };
+
+typedef struct {
+    const char *name;
+    uint8_t kind;
+    uint8_t raw;                // BENCH_MIX_*, raw mixes
+    int16_t rate;               // > 0 sets every stream to this rate
+    uint16_t list_period_ms;    // parameter list requests, 0 none
+    uint16_t sets_per_s;        // parameter changes reported per second
+} bench_mix_t;
+
+/*
+ * Raw mixes send one message type as fast as the TX ring takes it, like
+ * the on-target benchmark. Scheduler mixes run telemetry_update() at
+ * TELEMETRY_TICK_HZ with the drive loop feeding the tuning log at 200 Hz.
+ */
+static const bench_mix_t mixes[] = {
+    { "raw-hb",         MIX_RAW,   BENCH_MIX_HEARTBEAT, 0, 0, 0 },
+    { "raw-param",      MIX_RAW,   BENCH_MIX_PARAM,     0, 0, 0 },
+    { "raw-data96",     MIX_RAW,   BENCH_MIX_DATA96,    0, 0, 0 },
+    { "raw-telem",      MIX_RAW,   BENCH_MIX_TELEMETRY, 0, 0, 0 },
+    { "sr-defaults",    MIX_SCHED, 0,                   0, 0, 0 },
+    { "sr-param-list",  MIX_SCHED, 0,                   0, 2000, 0 },
+    { "sr-param-set",   MIX_SCHED, 0,                   0, 0, 50 },
+    { "sr-saturated",   MIX_SCHED, 0,                   50, 2000, 50 },
+};
+#define NUM_MIXES           (sizeof(mixes) / sizeof(mixes[0]))
+
+typedef struct {
+    uint64_t *latency_ns;       // UART1 frames
+    uint32_t n;
+    uint32_t parsed[MAVLINK_NUM_LINKS];
+    uint32_t seq_gaps[MAVLINK_NUM_LINKS];
+    int16_t last_seq[MAVLINK_NUM_LINKS];
+} bench_result_t;
+
+static bench_result_t result;
+static int16_t default_rates[NUM_STREAMS];
+
+static uint8_t link_of(const uart_dma_t *udp) {
+    return udp == &UDD1 ? MAVLINK_COMM_UART1 : MAVLINK_COMM_UART3;
+}
+
+// The GCS end, parsed on the channels the firmware doesn't send on
+static void on_byte(uart_dma_t *udp, uint8_t c, uint64_t t_ns) {
+    uint8_t link = link_of(udp);
+    mavlink_message_t msg;
+    mavlink_status_t status;
+    (void) t_ns;
+
+    if(!mavlink_parse_char(MAVLINK_NUM_LINKS + link, c, &msg, &status))
+        return;
+    if(result.last_seq[link] >= 0 && msg.seq != (uint8_t)(result.last_seq[link] + 1))
+        result.seq_gaps[link]++;
+    result.last_seq[link] = msg.seq;
+    result.parsed[link]++;
+}
+
+static void on_frame(uart_dma_t *udp, uint16_t len, uint64_t latency_ns) {
+    (void) len;
+    if(udp == &UDD1 && result.n < MAX_LATENCIES)
+        result.latency_ns[result.n++] = latency_ns;
+}
+
+static const uart_loop_sink_t sink = { on_byte, on_frame };
+
+// Advance the simulated time, delivering the bytes on the way
+static void advance_to(uint64_t t_ns) {
+    uart_loop_run(t_ns);
+    host_set_time_ns(t_ns);
+}
+
+// Same messages as the on-target benchmark
+static void send_raw(mavlink_channel_t chan, uint8_t mix, uint32_t n) {
+    static const uint8_t data[96];
+    static const char name[AP_MAX_NAME_SIZE] = "BENCH";
+
+    if(mix == BENCH_MIX_TELEMETRY)
+        mix = BENCH_MIX_HEARTBEAT + n % 4;
+    switch(mix) {
+    case BENCH_MIX_HEARTBEAT:
+        mavlink_msg_heartbeat_send(chan, MAV_TYPE_GIMBAL, MAV_AUTOPILOT_INVALID, 0, 0, MAV_STATE_ACTIVE);
+        break;
+    case BENCH_MIX_PARAM:
+        mavlink_msg_param_value_send(chan, name, (float)n, MAV_PARAM_TYPE_REAL32, 1, 0);
+        break;
+    case BENCH_MIX_DATA96:
+        mavlink_msg_data96_send(chan, 0, sizeof(data), data);
+        break;
+    default:
+        mavlink_msg_rc_channels_raw_send(chan, n, 0, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 1500, 255);
+        break;
+    }
+}
+
+// Offer frames back to back, waiting for the line whenever the ring is full
+static void run_raw(const bench_mix_t *mix, uint64_t end_ns) {
+    uint32_t n = 0;
+
+    while(host_time_ns() < end_ns) {
+        if(UDD1.tx_count >= MAVLINK_TX_FRAMES) {
+            advance_to(uart_loop_next_ns());
+            continue;
+        }
+        mavlink_lock(MAVLINK_COMM_UART1);
+        send_raw(MAVLINK_COMM_UART1, mix->raw, n++);
+        mavlink_unlock(MAVLINK_COMM_UART1);
+    }
+}
+
+// One 8 channel frame every 20 ms, as a PPM receiver publishes them
+static void publish_rc_frame(void) {
+    rc_frame_t frame;
+
+    memset(&frame, 0, sizeof(frame));
+    for(uint8_t i = 0; i < 8; i++)
+        frame.channels[i] = 1500 + 10 * i;
+    frame.num_channels = 8;
+    frame.timestamp = chVTGetSystemTimeX();
+    topic_publish(&rc_frame_topic, &frame);
+}
+
+static void run_sched(const bench_mix_t *mix, uint64_t start_ns, uint64_t end_ns) {
+    uint32_t sets = 0;
+
+    for(uint64_t t = start_ns; t < end_ns; t += NS_PER_MS) {
+        uint64_t ms = (t - start_ns) / NS_PER_MS;
+        float x = (float)ms / 1000.0f;
+
+        advance_to(t);
+        if(ms % 20 == 0)
+            publish_rc_frame();
+        if(ms % 5 == 0)
+            tune_log_capture(TUNE_LOG_DRIVE, 5000, sinf(x), sinf(x) * 0.9f,
+                    0.1f, 0.01f * x, 0, 5000 + 2500 * sinf(x));
+        if(mix->list_period_ms > 0 && ms % mix->list_period_ms == 0)
+            telemetry_request_param_list();
+        if(mix->sets_per_s > 0 && ms * mix->sets_per_s / 1000 >= sets) {
+            send_parameter_value_all("RC_EXPO", AP_PARAM_INT16, (float)(sets % 100));
+            sets++;
+        }
+        if(ms % (1000 / TELEMETRY_TICK_HZ) == 0)
+            telemetry_update();
+    }
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t percentile_us(uint8_t percent) {
+    if(result.n == 0)
+        return 0;
+    uint32_t i = (uint32_t)(((uint64_t)result.n * percent + 99) / 100);
+    return (uint32_t)(result.latency_ns[i > 0 ? i - 1 : 0] / 1000);
+}
+
+static void run_mix(const bench_mix_t *mix, uint32_t seconds) {
+    const uart_dma_tx_stats_t *txs = mavlink_tx_stats(MAVLINK_COMM_UART1);
+    const uart_dma_tx_stats_t *txs3 = mavlink_tx_stats(MAVLINK_COMM_UART3);
+    const time_measurement_t *tm = mavlink_tx_time(MAVLINK_COMM_UART1);
+    uint64_t start = host_time_ns();
+    uint64_t end = start + seconds * 1000 * NS_PER_MS;
+    rttime_t cpu_start = tm->cumulative;
+    ucnt_t n_start = tm->n;
+
+    result.n = 0;
+    for(uint8_t i = 0; i < MAVLINK_NUM_LINKS; i++) {
+        result.parsed[i] = 0;
+        result.seq_gaps[i] = 0;
+        result.last_seq[i] = -1;
+    }
+    uart_loop_reset_stats();
+    for(uint8_t i = 0; i < NUM_STREAMS; i++)
+        stream_rates[i] = mix->rate > 0 ? mix->rate : default_rates[i];
+    pid_report = TUNE_LOG_DRIVE;
+
+    if(mix->kind == MIX_RAW)
+        run_raw(mix, end);
+    else
+        run_sched(mix, start, end);
+
+    // let the rings drain so every message sent has a latency
+    while(uart_loop_next_ns() != UINT64_MAX)
+        advance_to(uart_loop_next_ns());
+    advance_to(host_time_ns() + 100 * NS_PER_MS);
+
+    qsort(result.latency_ns, result.n, sizeof(uint64_t), cmp_u64);
+    uint64_t cpu_ns = tm->n > n_start ?
+            (tm->cumulative - cpu_start) * 1000 / (STM32_HCLK / 1000000) / (tm->n - n_start) : 0;
+    uint32_t line_pct = (uint32_t)((uint64_t)txs->bytes * 10 * 100 / MAVLINK_BAUD / seconds);
+
+    printf("%-14s %7lu %7lu %5lu %7lu %7lu %7lu %7lu %7lu %6lu %5lu %6llu\n", mix->name,
+            (unsigned long)(txs->frames / seconds), (unsigned long)(txs->bytes / seconds),
+            (unsigned long)line_pct,
+            (unsigned long)percentile_us(50), (unsigned long)percentile_us(90),
+            (unsigned long)percentile_us(99), (unsigned long)percentile_us(100),
+            (unsigned long)txs->dropped,
+            (unsigned long)(result.seq_gaps[0] + result.seq_gaps[1]),
+            (unsigned long)(txs->frames - result.parsed[0] + txs3->frames - result.parsed[1]),
+            (unsigned long long)cpu_ns);
+}
+
+int main(int argc, char **argv) {
+    uint32_t seconds = 10;
+    int opt;
+
+    while((opt = getopt(argc, argv, "t:")) != -1) {
+        switch(opt) {
+        case 't':
+            seconds = (uint32_t)atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t seconds] [mix ...]\n", argv[0]);
+            return 2;
+        }
+    }
+    if(seconds == 0)
+        seconds = 1;
+
+    result.latency_ns = malloc(MAX_LATENCIES * sizeof(uint64_t));
+    if(result.latency_ns == NULL)
+        return 1;
+
+    load_parameters();
+    memcpy(default_rates, stream_rates, sizeof(default_rates));
+    uart_loop_set_sink(&sink);
+    init_mavlink_links();
+    init_telemetry();
+
+    printf("%u baud, %u TX frames per link, %lu s per mix, latency reserve to last byte parsed\n",
+            MAVLINK_BAUD, MAVLINK_TX_FRAMES, (unsigned long)seconds);
+    printf("%-14s %7s %7s %5s %7s %7s %7s %7s %7s %6s %5s %6s\n", "mix", "msg/s", "B/s", "line%",
+            "p50us", "p90us", "p99us", "maxus", "dropped", "gaps", "lost", "cpu_ns");
+    for(uint8_t i = 0; i < NUM_MIXES; i++) {
+        bool run = optind >= argc;
+        for(int a = optind; a < argc; a++)
+            run |= strcmp(argv[a], mixes[i].name) == 0;
+        if(run)
+            run_mix(&mixes[i], seconds);
+    }
+    free(result.latency_ns);
+    return 0;
+}
@@ -0,0 +1,15 @@
+#include <stdio.h>
+
+#include "rc_check.h"
+
+/*
+ * Host runner of the RC decoder checks, the same table the firmware runs
+ * on MAV_CMD_USER_3.
+ */
+int main(void) {
+    uint32_t failed = rc_check_run();
+
+    for(uint8_t i = 0; i < rc_check_count(); i++)
+        printf("%-16s %s\n", rc_check_name(i), failed & (1UL << i) ? "FAIL" : "ok");
+    return failed ? 1 : 0;
+}
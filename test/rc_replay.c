@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "rc_decode.h"
+
+/*
+ * Decodes a recorded RC edge trace (tools/rc_trace_dump.py) the way the
+ * firmware does and prints one line per frame
+ *   time_us channels ch0 ch1 ...
+ * or time_us lost. Decode time per event goes to stderr.
+ *
+ *   rc_replay [-m pwm|ppm] [-f median,rate_max,deadband,expo] trace.bin
+ */
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void print_result(const rc_decoder_t *dec, const rc_trace_event_t *ev, uint8_t res) {
+    if(res & RC_DECODE_FRAME) {
+        printf("%u %u", ev->time_us, dec->num_channels);
+        for(uint8_t i = 0; i < dec->num_channels; i++)
+            printf(" %u", dec->channels[i]);
+        printf("\n");
+    }
+    if(res & RC_DECODE_LOST)
+        printf("%u lost\n", ev->time_us);
+}
+
+int main(int argc, char **argv) {
+    static rc_decoder_t dec;
+    rc_filter_config_t cfg = { 0, 0, 0, 0 };
+    const rc_filter_config_t *filter = NULL;
+    uint8_t mode = RC_INPUT_PWM;
+    rc_trace_event_t ev, prev;
+    uint64_t total_ns = 0, max_ns = 0;
+    size_t n = 0;
+    FILE *f;
+    int opt;
+
+    while((opt = getopt(argc, argv, "m:f:")) != -1) {
+        switch(opt) {
+        case 'm':
+            mode = strcmp(optarg, "ppm") == 0 ? RC_INPUT_PPM : RC_INPUT_PWM;
+            break;
+        case 'f':
+            if(sscanf(optarg, "%hd,%hd,%hd,%hd", &cfg.median, &cfg.rate_max,
+                    &cfg.deadband, &cfg.expo) != 4) {
+                fprintf(stderr, "-f takes median,rate_max,deadband,expo\n");
+                return 2;
+            }
+            filter = &cfg;
+            break;
+        default:
+            return 2;
+        }
+    }
+    if(optind >= argc) {
+        fprintf(stderr, "usage: %s [-m pwm|ppm] [-f median,rate_max,deadband,expo] trace.bin\n", argv[0]);
+        return 2;
+    }
+    f = fopen(argv[optind], "rb");
+    if(f == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    rc_decode_init(&dec, mode, filter);
+    while(fread(&ev, sizeof(ev), 1, f) == 1) {
+        // the firmware timeout fires on gaps, the recorder doesn't see it
+        if(n > 0 && ev.type != RC_EVT_TIMEOUT && ev.time_us - prev.time_us >= RC_TIMEOUT_US) {
+            rc_trace_event_t timeout = { prev.time_us + RC_TIMEOUT_US, 0, RC_EVT_TIMEOUT, 0 };
+            print_result(&dec, &timeout, rc_decode_event(&dec, &timeout));
+        }
+
+        uint64_t start = now_ns();
+        uint8_t res = rc_decode_event(&dec, &ev);
+        uint64_t ns = now_ns() - start;
+        total_ns += ns;
+        if(ns > max_ns)
+            max_ns = ns;
+
+        print_result(&dec, &ev, res);
+        prev = ev;
+        n++;
+    }
+    fclose(f);
+
+    fprintf(stderr, "%zu events, decode avg %.0f ns max %llu ns\n", n,
+            n > 0 ? (double)total_ns / n : 0.0, (unsigned long long)max_ns);
+    return 0;
+}
@@ -0,0 +1,69 @@
+#!/usr/bin/env python
+"""
+Compare the flash and RAM footprint of two builds of the firmware, in
+total and per function.
+
+    build_compare.py build/debug/SToRM32.elf build/release/SToRM32.elf
+
+Run by `make compare` after building both variants. Flash is text + data,
+RAM is data + bss as reported by size.
+"""
+from __future__ import print_function
+
+import argparse
+import subprocess
+
+
+def run(cmd):
+    return subprocess.check_output(cmd).decode('ascii', 'replace')
+
+
+def sizes(size_tool, elf):
+    # berkeley format: text data bss dec hex filename
+    line = run([size_tool, elf]).splitlines()[1].split()
+    text, data, bss = int(line[0]), int(line[1]), int(line[2])
+    return text + data, data + bss
+
+
+def functions(nm_tool, elf):
+    result = {}
+    for line in run([nm_tool, '--print-size', '--size-sort', elf]).splitlines():
+        fields = line.split()
+        if len(fields) != 4 or fields[2] not in 'tTwW':
+            continue
+        result[fields[3]] = int(fields[1], 16)
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--size', default='arm-none-eabi-size')
+    parser.add_argument('--nm', default='arm-none-eabi-nm')
+    parser.add_argument('--top', type=int, default=25,
+                        help='number of functions to list')
+    parser.add_argument('base')
+    parser.add_argument('other')
+    args = parser.parse_args()
+
+    base_flash, base_ram = sizes(args.size, args.base)
+    other_flash, other_ram = sizes(args.size, args.other)
+    print('%-8s %10s %10s %8s' % ('', 'base', 'other', 'change'))
+    for name, a, b in (('flash', base_flash, other_flash),
+                       ('ram', base_ram, other_ram)):
+        print('%-8s %10d %10d %+7.1f%%' % (name, a, b, 100.0 * (b - a) / a))
+
+    base_fn = functions(args.nm, args.base)
+    other_fn = functions(args.nm, args.other)
+    names = set(base_fn) | set(other_fn)
+    rows = sorted(names, key=lambda n: -max(base_fn.get(n, 0), other_fn.get(n, 0)))
+    print()
+    print('%-40s %8s %8s %8s' % ('function', 'base', 'other', 'change'))
+    for n in rows[:args.top]:
+        a = base_fn.get(n, 0)
+        b = other_fn.get(n, 0)
+        # missing in one build, inlined or dropped by LTO
+        print('%-40s %8s %8s %+8d' % (n[:40], a or '-', b or '-', b - a))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,170 @@
+#!/usr/bin/env python
+"""
+Turn kernel trace dumps from a telemetry log into a Chrome trace timeline.
+
+    kernel_trace_view.py flight.tlog > trace.json
+
+Open the result in chrome://tracing or ui.perfetto.dev. Per thread run
+and wait statistics go to stderr. The dump is requested with
+MAV_CMD_USER_2, see src/kernel_trace.h for the frame format. Times have
+the resolution of the system tick.
+"""
+from __future__ import print_function
+
+import argparse
+import json
+import struct
+import sys
+
+from pymavlink import mavutil
+
+KERNEL_TRACE_DATA_TYPE = 0x4B
+KIND_THREADS = 0
+KIND_EVENTS = 1
+HEADER = struct.Struct('<BBBBIH')
+THREAD = struct.Struct('<I12s')
+EVENT = struct.Struct('<IBxII')
+
+# ChibiOS 16.1 thread states
+STATES = ('READY', 'CURRENT', 'WTSTART', 'SUSPENDED', 'QUEUED', 'WTSEM',
+          'WTMTX', 'WTCOND', 'SLEEPING', 'WTEXIT', 'WTOREVT', 'WTANDEVT',
+          'SNDMSGQ', 'SNDMSG', 'WTMSG', 'FINAL')
+
+
+class Dump(object):
+    def __init__(self, dump_id):
+        self.id = dump_id
+        self.tick_hz = None
+        self.threads = {}
+        self.events = {}
+        self.num_events = None
+
+    def complete(self):
+        return self.num_events is not None and len(self.events) == self.num_events
+
+
+def read_dumps(log):
+    mlog = mavutil.mavlink_connection(log)
+    dumps = []
+    while True:
+        msg = mlog.recv_match(type='DATA96')
+        if msg is None:
+            break
+        if msg.type != KERNEL_TRACE_DATA_TYPE:
+            continue
+        data = bytearray(msg.data[:msg.len])
+        kind, dump_id, count, first, tick_hz, total = HEADER.unpack_from(data)
+        if not dumps or dumps[-1].id != dump_id:
+            dumps.append(Dump(dump_id))
+        dump = dumps[-1]
+        dump.tick_hz = tick_hz
+        pos = HEADER.size
+        if kind == KIND_EVENTS:
+            dump.num_events = total
+        for i in range(count):
+            if kind == KIND_THREADS:
+                tp, name = THREAD.unpack_from(data, pos)
+                dump.threads[tp] = name.split(b'\0')[0].decode('ascii', 'replace')
+                pos += THREAD.size
+            else:
+                dump.events[first + i] = EVENT.unpack_from(data, pos)
+                pos += EVENT.size
+    return dumps
+
+
+def state_name(state):
+    return STATES[state] if state < len(STATES) else str(state)
+
+
+def timeline(dump):
+    """Running slices (thread, start us, end us, state left in, wait object)."""
+    # records never written by the target have no thread
+    events = [dump.events[i] for i in sorted(dump.events) if dump.events[i][2] != 0]
+    us_per_tick = 1e6 / dump.tick_hz
+    slices = []
+    t = 0
+    for prev, cur in zip(events, events[1:]):
+        # 32 bit system time, the ring spans far less than a wrap
+        dt = (cur[0] - prev[0]) & 0xFFFFFFFF
+        start = t
+        t += dt * us_per_tick
+        slices.append((prev[2], start, t, cur[1], cur[3]))
+    return slices
+
+
+def thread_label(dump, tp):
+    return dump.threads.get(tp, '0x%08x' % tp)
+
+
+def chrome_trace(dump, slices):
+    tids = {}
+    out = []
+    for tp, start, end, state, wtobj in slices:
+        tid = tids.setdefault(tp, len(tids) + 1)
+        out.append({'name': thread_label(dump, tp), 'ph': 'X', 'pid': 1,
+                    'tid': tid, 'ts': start, 'dur': end - start,
+                    'args': {'switched_out': state_name(state),
+                             'wait_object': '0x%08x' % wtobj}})
+    for tp, tid in tids.items():
+        out.append({'name': 'thread_name', 'ph': 'M', 'pid': 1, 'tid': tid,
+                    'args': {'name': thread_label(dump, tp)}})
+    return out
+
+
+def report(dump, slices, f):
+    """Run time and the time from switch out to switch in per thread. A
+    thread switched out READY was preempted, the threads that ran until
+    it got back in form the preemption chain."""
+    stats = {}
+    pending = {}    # thread -> (switched out at, state, wtobj, threads ran)
+    for tp, start, end, state, wtobj in slices:
+        s = stats.setdefault(tp, {'runs': 0, 'run_us': 0.0, 'max_run_us': 0.0,
+                                  'waits': {}})
+        if tp in pending:
+            out_t, out_state, out_obj, ran = pending.pop(tp)
+            w = s['waits'].setdefault(out_state, [0, 0.0, 0.0, None])
+            w[0] += 1
+            w[1] += start - out_t
+            if start - out_t >= w[2]:
+                w[2] = start - out_t
+                w[3] = (out_obj, ran)
+        for other in pending.values():
+            if tp not in other[3]:
+                other[3].append(tp)
+        s['runs'] += 1
+        s['run_us'] += end - start
+        s['max_run_us'] = max(s['max_run_us'], end - start)
+        pending[tp] = (end, state, wtobj, [])
+
+    span = slices[-1][2] if slices else 0
+    print('dump %u, %.0f us, %u switches' % (dump.id, span, len(slices)), file=f)
+    for tp, s in sorted(stats.items(), key=lambda i: -i[1]['run_us']):
+        print('%-12s runs %4u  cpu %5.1f%%  max run %8.0f us' % (
+            thread_label(dump, tp), s['runs'],
+            100.0 * s['run_us'] / span if span else 0, s['max_run_us']), file=f)
+        for state, (n, total, worst, (obj, ran)) in sorted(s['waits'].items()):
+            print('    %-10s n %4u  avg %8.0f us  max %8.0f us  obj 0x%08x  ran: %s' % (
+                state_name(state), n, total / n, worst, obj,
+                ' '.join(thread_label(dump, r) for r in ran)), file=f)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().split('\n')[0])
+    parser.add_argument('log', help='tlog file or MAVLink connection string')
+    parser.add_argument('--dump', type=int, default=-1,
+                        help='dump to convert, by position in the log (default last)')
+    args = parser.parse_args()
+
+    dumps = [d for d in read_dumps(args.log) if d.complete()]
+    if not dumps:
+        print('no complete trace dump in the log', file=sys.stderr)
+        sys.exit(1)
+    dump = dumps[args.dump]
+    slices = timeline(dump)
+    json.dump({'traceEvents': chrome_trace(dump, slices),
+               'displayTimeUnit': 'ms'}, sys.stdout, indent=1)
+    report(dump, slices, sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,82 @@
+#!/usr/bin/env python
+"""
+Extract RC edge trace dumps from a telemetry log for replay on the host.
+
+    rc_trace_dump.py flight.tlog rc
+
+writes every complete dump to rc-<n>.bin, the raw rc_trace_event_t array
+that test/build/rc_replay decodes. The capture is requested with
+MAV_CMD_USER_4 on an RC_CHECK build, see src/rc_trace.h for the frame
+format.
+"""
+from __future__ import print_function
+
+import argparse
+import struct
+import sys
+
+from pymavlink import mavutil
+
+RC_TRACE_DATA_TYPE = 0x52
+HEADER = struct.Struct('<BBHHBx')
+EVENT_SIZE = 8
+MODES = {0: 'pwm', 1: 'ppm'}
+
+
+class Dump(object):
+    def __init__(self, dump_id, total, mode):
+        self.id = dump_id
+        self.total = total
+        self.mode = mode
+        self.events = {}
+
+    def complete(self):
+        return len(self.events) == self.total
+
+
+def read_dumps(log):
+    mlog = mavutil.mavlink_connection(log)
+    dumps = []
+    dump = None
+    while True:
+        msg = mlog.recv_match(type='DATA96')
+        if msg is None:
+            break
+        if msg.type != RC_TRACE_DATA_TYPE:
+            continue
+        data = bytes(bytearray(msg.data))
+        dump_id, count, first, total, mode = HEADER.unpack_from(data)
+        if dump is None or dump.id != dump_id or first == 0:
+            dump = Dump(dump_id, total, mode)
+            dumps.append(dump)
+        for i in range(count):
+            pos = HEADER.size + i * EVENT_SIZE
+            dump.events[first + i] = data[pos:pos + EVENT_SIZE]
+    return dumps
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('log')
+    parser.add_argument('prefix')
+    args = parser.parse_args()
+
+    n = 0
+    for dump in read_dumps(args.log):
+        if not dump.complete():
+            print('dump %d incomplete, %d of %d events' %
+                  (dump.id, len(dump.events), dump.total), file=sys.stderr)
+            continue
+        n += 1
+        name = '%s-%d.bin' % (args.prefix, n)
+        with open(name, 'wb') as f:
+            for i in range(dump.total):
+                f.write(dump.events[i])
+        print('%s: %d events, replay with rc_replay -m %s %s' %
+              (name, dump.total, MODES.get(dump.mode, 'pwm'), name))
+    return 0 if n > 0 else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
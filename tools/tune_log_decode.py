@@ -0,0 +1,100 @@
+#!/usr/bin/env python
+"""
+Rebuild the PID tuning log from the DATA96 messages in a telemetry log.
+
+    tune_log_decode.py flight.tlog > tune.csv
+
+See src/tune_log.h for the frame format.
+"""
+from __future__ import print_function
+
+import argparse
+import struct
+import sys
+
+from pymavlink import mavutil
+
+TUNE_LOG_DATA_TYPE = 0x54
+TUNE_LOG_SCALE = 1000.0
+HEADER = struct.Struct('<BBBBHI')
+SIGNALS = ('setpoint', 'measurement', 'p', 'i', 'd', 'output')
+CONTROLLERS = {0: 'volt', 1: 'rpm', 2: 'drive'}
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        b = data[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            break
+    # zigzag
+    return (value >> 1) ^ -(value & 1), pos
+
+
+def decode_frame(data):
+    seq, controller, count, dropped, period_us, first = HEADER.unpack_from(data)
+    pos = HEADER.size
+    samples = []
+    prev = None
+    for _ in range(count):
+        values = []
+        for i in range(len(SIGNALS)):
+            v, pos = read_varint(data, pos)
+            values.append(v if prev is None else prev[i] + v)
+        samples.append(values)
+        prev = values
+    return seq, controller, period_us, first, dropped, samples
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().split('\n')[0])
+    parser.add_argument('log', help='tlog file or MAVLink connection string')
+    args = parser.parse_args()
+
+    mlog = mavutil.mavlink_connection(args.log)
+    print('time_s,controller,' + ','.join(SIGNALS))
+
+    last_seq = None
+    lost_frames = 0
+    next_index = None
+    gaps = 0
+    dropped_samples = 0
+    while True:
+        msg = mlog.recv_match(type='DATA96')
+        if msg is None:
+            break
+        if msg.type != TUNE_LOG_DATA_TYPE:
+            continue
+        data = bytearray(msg.data[:msg.len])
+        seq, controller, period_us, first, dropped, samples = decode_frame(data)
+        if last_seq is not None and seq != (last_seq + 1) & 0xFF:
+            lost_frames += (seq - last_seq - 1) & 0xFF
+        last_seq = seq
+        # the capture index counts samples dropped on the target and samples
+        # of lost frames, any jump is a gap in the series
+        if next_index is not None and first != next_index:
+            missing = (first - next_index) & 0xFFFFFFFF
+            gaps += 1
+            dropped_samples += missing
+            print('gap of %u samples at %.6f s (%u dropped on target)' %
+                  (missing, first * period_us * 1e-6, dropped), file=sys.stderr)
+        next_index = (first + len(samples)) & 0xFFFFFFFF
+
+        name = CONTROLLERS.get(controller, str(controller))
+        for n, values in enumerate(samples):
+            t = (first + n) * period_us * 1e-6
+            print('%.6f,%s,' % (t, name) +
+                  ','.join('%.3f' % (v / TUNE_LOG_SCALE) for v in values))
+
+    if lost_frames:
+        print('%u frames lost' % lost_frames, file=sys.stderr)
+    if gaps:
+        print('%u gaps, %u samples missing' % (gaps, dropped_samples), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()